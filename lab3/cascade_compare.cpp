@@ -0,0 +1,202 @@
+// 在有標註的圖片集上比較不同 cascade (Haar / LBP) 的 recall、false positive 和每張的偵測時間，
+// 偵測參數和 lab3-1 相同 (face_pipeline::detect_faces)。
+// 標註檔格式和 opencv_createsamples 的 info 檔一樣，一行一張圖：
+//   <image_path> <n> x1 y1 w1 h1 ... xn yn wn hn
+// 用法：
+//   ./cascade_compare <annotations.txt> <cascade.xml> [cascade.xml...]
+//                     [--downscale 2] [--scale 1.1] [--min-neighbors 6] [--iou 0.5] [--csv out.csv]
+//                     [--detect-threads N]
+//                     [--native]   (Haar cascade 另外再用 haar_fixed.h 的定點數偵測器跑一次)
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "face_pipeline.h"
+
+struct labeled_image
+{
+    std::string path;
+    std::vector<cv::Rect> faces;
+};
+
+bool load_annotations(const std::string &path, std::vector<labeled_image> &images)
+{
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+    // 圖片路徑相對於標註檔所在的資料夾
+    std::string base;
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos) base = path.substr(0, slash + 1);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        labeled_image img;
+        int n = 0;
+        if (!(ss >> img.path >> n)) continue;
+        if (img.path[0] == '#') continue;
+        if (img.path[0] != '/') img.path = base + img.path;
+        for (int i = 0; i < n; ++i) {
+            cv::Rect r;
+            if (!(ss >> r.x >> r.y >> r.width >> r.height)) break;
+            img.faces.push_back(r);
+        }
+        images.push_back(img);
+    }
+    return true;
+}
+
+double iou(const cv::Rect &a, const cv::Rect &b)
+{
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+struct compare_result
+{
+    std::string cascade;
+    std::string type;
+    int gt = 0;
+    int tp = 0;
+    int fp = 0;
+    int images = 0;
+    std::vector<double> ms;
+};
+
+// 貪婪配對：每個偵測框配給 IoU 最高且還沒被配走的標註
+void match(const std::vector<cv::Rect> &gt, const std::vector<cv::Rect> &det, double min_iou, int &tp, int &fp)
+{
+    std::vector<bool> used(gt.size(), false);
+    for (const auto &d : det) {
+        int best = -1;
+        double best_iou = min_iou;
+        for (size_t g = 0; g < gt.size(); ++g) {
+            if (used[g]) continue;
+            double v = iou(gt[g], d);
+            if (v >= best_iou) {
+                best_iou = v;
+                best = (int)g;
+            }
+        }
+        if (best >= 0) {
+            used[best] = true;
+            tp++;
+        } else {
+            fp++;
+        }
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <annotations.txt> <cascade.xml> [cascade.xml...]"
+                  << " [--downscale d] [--scale s] [--min-neighbors n] [--iou t] [--csv out.csv] [--native] [--detect-threads N]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> cascades;
+    pipeline_config base_cfg;
+    double min_iou = 0.5;
+    std::string csv_path;
+    bool with_native = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--downscale" && i + 1 < argc) {
+            base_cfg.small_scale = atof(argv[++i]);
+        } else if (arg == "--scale" && i + 1 < argc) {
+            base_cfg.scale_factor = atof(argv[++i]);
+        } else if (arg == "--min-neighbors" && i + 1 < argc) {
+            base_cfg.min_neighbors = atoi(argv[++i]);
+        } else if (arg == "--iou" && i + 1 < argc) {
+            min_iou = atof(argv[++i]);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg == "--detect-threads" && i + 1 < argc) {
+            base_cfg.detect_threads = atoi(argv[++i]);
+        } else if (arg == "--native") {
+            with_native = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            cascades.push_back(arg);
+        }
+    }
+
+    std::vector<labeled_image> images;
+    if (!load_annotations(argv[1], images) || images.empty()) {
+        std::cerr << "Error: Cannot read annotations " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // 先把圖都讀進來，解碼時間不算進偵測
+    std::vector<cv::Mat> decoded;
+    for (const auto &img : images) {
+        decoded.push_back(cv::imread(img.path));
+        if (decoded.back().empty()) {
+            std::cerr << "Warning: Cannot read " << img.path << ", skipped." << std::endl;
+        }
+    }
+
+    stage_stats stats(pipeline_stage_names());
+    std::vector<compare_result> results;
+    std::vector<cv::Rect> det;
+    for (const auto &cascade : cascades) {
+        for (int native = 0; native <= (with_native ? 1 : 0); ++native) {
+            pipeline_config cfg = base_cfg;
+            cfg.cascade_path = cascade;
+            cfg.native_detector = (native == 1);
+            face_pipeline pipeline(cfg, stats);
+            if (!pipeline.load_cascade()) continue;
+
+            compare_result r;
+            r.cascade = cascade;
+            r.type = pipeline.cascade_type();
+            if (native) r.type += "-fx";
+            for (size_t i = 0; i < images.size(); ++i) {
+                if (decoded[i].empty()) continue;
+                auto t0 = std::chrono::steady_clock::now();
+                pipeline.detect_faces(decoded[i], det);
+                auto t1 = std::chrono::steady_clock::now();
+                r.ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+                r.gt += (int)images[i].faces.size();
+                match(images[i].faces, det, min_iou, r.tp, r.fp);
+                r.images++;
+            }
+            results.push_back(r);
+        }
+    }
+
+    std::printf("%-48s %-7s %7s %6s %8s %9s %9s\n", "cascade", "type", "recall", "FP", "FP/img", "ms/img", "p95 ms");
+    for (const auto &r : results) {
+        double mean_ms = 0.0;
+        for (double v : r.ms) mean_ms += v;
+        if (!r.ms.empty()) mean_ms /= r.ms.size();
+        std::printf("%-48s %-7s %6.1f%% %6d %8.2f %9.2f %9.2f\n", r.cascade.c_str(), r.type.c_str(),
+                    r.gt ? 100.0 * r.tp / r.gt : 0.0, r.fp, r.images ? (double)r.fp / r.images : 0.0,
+                    mean_ms, percentile(r.ms, 0.95));
+    }
+
+    if (!csv_path.empty()) {
+        std::ofstream csv(csv_path.c_str());
+        csv << "cascade,type,images,ground_truth,true_positives,false_positives,recall,ms_per_image,p95_ms\n";
+        for (const auto &r : results) {
+            double mean_ms = 0.0;
+            for (double v : r.ms) mean_ms += v;
+            if (!r.ms.empty()) mean_ms /= r.ms.size();
+            csv << r.cascade << "," << r.type << "," << r.images << "," << r.gt << "," << r.tp << "," << r.fp << ","
+                << (r.gt ? (double)r.tp / r.gt : 0.0) << "," << mean_ms << "," << percentile(r.ms, 0.95) << "\n";
+        }
+    }
+    return 0;
+}
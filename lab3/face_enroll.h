@@ -0,0 +1,105 @@
+#ifndef FACE_ENROLL_H
+#define FACE_ENROLL_H
+
+// 線上註冊：從鏡頭收集同一個人 N 張好的臉，交給 lbph_engine::enroll 加進模型
+// 開始後鎖定畫面中最大的那張臉的 track ID，之後只收這個 track 的臉，
+// 每張之間至少隔 interval 張 frame (角度、表情才有變化)，太小或太糊的臉不收。
+// 收集的時候辨識照常跑，收滿才一次算 histogram、寫 journal。
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct enroll_config
+{
+    int samples = 10;               // 要收幾張
+    int interval = 5;               // 兩張之間至少隔幾張 frame
+    int min_size = 80;              // 原始 frame 裡的臉框寬度至少多少 pixel (太小放大成 100x100 很糊)
+    double min_sharpness = 30.0;    // 100x100 的臉 Laplacian 的變異數，低於這個值當成晃動模糊
+    int lost_frames = 30;           // 鎖定的 track 消失幾張就放棄
+};
+
+class face_enroller
+{
+public:
+    explicit face_enroller(const enroll_config &config = enroll_config())
+        : cfg(config), running(false), enroll_label(-1), target(-1), since_last(0), lost(0) {}
+
+    bool active() const { return running; }
+    int label() const { return enroll_label; }
+    const std::string &name() const { return enroll_name; }
+    int target_id() const { return target; }
+    int collected() const { return (int)faces.size(); }
+    int samples() const { return cfg.samples; }
+    const std::vector<cv::Mat> &crops() const { return faces; }
+
+    void start(int label, const std::string &name, int samples)
+    {
+        running = true;
+        enroll_label = label;
+        enroll_name = name;
+        if (samples > 0) cfg.samples = samples;
+        target = -1;
+        since_last = cfg.interval;
+        lost = 0;
+        faces.clear();
+    }
+
+    void stop()
+    {
+        running = false;
+        target = -1;
+        faces.clear();
+    }
+
+    // 這張 frame 要收哪一張臉 (ids 和 boxes 一一對應)，回傳 index，這張不收就是 -1。
+    // 鎖定的 track 消失太久回傳 -1 並把 lost_target() 設成 true
+    int select(const std::vector<int> &ids, const std::vector<cv::Rect> &boxes)
+    {
+        since_last++;
+        if (target < 0) {
+            int best = -1;
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                if (best < 0 || boxes[i].area() > boxes[best].area()) best = (int)i;
+            }
+            if (best < 0 || ids[best] < 0) return -1;
+            target = ids[best];
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] != target) continue;
+            lost = 0;
+            if (since_last < cfg.interval || boxes[i].width < cfg.min_size) return -1;
+            return (int)i;
+        }
+        lost++;
+        return -1;
+    }
+
+    bool lost_target() const { return target >= 0 && lost > cfg.lost_frames; }
+
+    // 100x100 equalize 過的臉，夠清楚就收下。收滿回傳 true
+    bool add(const cv::Mat &crop)
+    {
+        cv::Mat lap;
+        cv::Scalar mean, dev;
+        cv::Laplacian(crop, lap, CV_16S);
+        cv::meanStdDev(lap, mean, dev);
+        if (dev[0] * dev[0] < cfg.min_sharpness) return false;
+        faces.push_back(crop.clone());
+        since_last = 0;
+        return (int)faces.size() >= cfg.samples;
+    }
+
+private:
+    enroll_config cfg;
+    bool running;
+    int enroll_label;
+    std::string enroll_name;
+    int target;         // 鎖定的 track ID
+    int since_last;     // 距離上一張收下的 frame 數
+    int lost;           // 鎖定的 track 連續幾張沒出現
+    std::vector<cv::Mat> faces;
+};
+
+#endif // FACE_ENROLL_H
@@ -0,0 +1,685 @@
+#ifndef FACE_PIPELINE_H
+#define FACE_PIPELINE_H
+
+// lab3-1 的偵測 + 辨識流程 (gray + 縮小 + equalize → detect → recognize)
+// framebuffer 顯示、headless 輸出和 benchmark 都呼叫同一份，量到的就是實際在跑的
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/face.hpp>
+
+#include "stage_stats.h"
+#include "haar_fixed.h"
+#include "motion_gate.h"
+#include "face_tracker.h"
+#include "track_assoc.h"
+#include "recog_cache.h"
+#include "work_pool.h"
+#include "preprocess.h"
+#include "pyramid.h"
+#include "face_enroll.h"
+#include "file_watcher.h"
+#include "lbph_engine.h"
+
+enum {
+    STAGE_CAPTURE, STAGE_GRAY, STAGE_RESIZE, STAGE_MOTION, STAGE_DETECT, STAGE_TRACK, STAGE_RECOGNIZE,
+    STAGE_COMPOSE, STAGE_CONVERT, STAGE_FB_WRITE, STAGE_COUNT
+};
+
+inline std::vector<std::string> pipeline_stage_names()
+{
+    return { "capture", "gray", "resize", "motion", "detect", "track", "recognize", "compose", "rgb565", "fb_write" };
+}
+
+struct pipeline_config
+{
+    // 也可以換成 LBP cascade，例如 ./lbpcascades/lbpcascade_frontalface_improved.xml
+    std::string cascade_path = "./haarcascades/haarcascade_frontalface_default.xml";
+    double small_scale = 2.0;       // 偵測前縮小的倍數
+    double scale_factor = 1.1;      // detectMultiScale 的 pyramid 倍率
+    int min_neighbors = 6;
+    bool native_detector = false;   // true: 用 haar_fixed.h 的定點數偵測器取代 detectMultiScale
+    bool motion_gate = false;       // true: 只在有動的區域偵測 (motion_gate.h)
+    motion_config motion;
+    bool tracker = false;           // true: 偵測之間用 MOSSE tracker 跟著臉走 (face_tracker.h)
+    tracker_config track;
+    bool roi_redetect = false;      // true: 上一張有臉時只在臉的附近找
+    int roi_full_interval = 15;     // roi_redetect 時每幾張整張掃一次，才找得到新進來的人
+    double roi_margin = 0.5;        // 搜尋範圍 = 上一個框往四周擴大框大小的這個比例
+    double roi_min_ratio = 0.7;     // 搜尋的臉大小 = 上一個框的 0.7 ~ 1.4 倍
+    double roi_max_ratio = 1.4;
+    int detect_threads = 1;         // > 1: pyramid 的層分給 work_pool 平行偵測
+    assoc_config assoc;             // 框 → track ID 的關聯和平滑 (track_assoc.h)
+    recog_cache_config recog;       // 每個 track 的辨識快取 (recog_cache.h)，預設不開
+    int recognize_threads = 1;      // > 1: 同一張 frame 的多張臉分給 work_pool 平行 predict
+    bool pyramid_crops = false;     // true: 大的臉從 pyramid 比較小的層切 (比較快，但和 lbph_train 的切法不同)
+    enroll_config enroll;           // 線上註冊收臉的條件 (face_enroll.h)
+    int top_k = 1;                  // 每張臉取最近的幾個人 (有個別門檻時至少 2，第一名被擋掉可以換第二名)
+    lbph_open_set open_set;         // Unknown 的門檻 (預設不擋，和 LBPHFaceRecognizer::predict 相同)
+};
+
+struct face_result
+{
+    cv::Rect box;           // 原始 frame 座標
+    int id;                 // track ID，同一張臉在連續的 frame 裡不變
+    int label;              // -1 = Unknown (沒有人通過 open_set 的門檻)
+    double confidence;      // LBPH 距離，越低越像 (Unknown 時是最近的那個人的距離)
+};
+
+// 辨識模型：lbph_convert / lbph_train 的二進位模型用 lbph_engine (mmap)，YAML 交給 OpenCV。
+// 熱更新時整個物件換掉，還在用舊模型的人拿著 shared_ptr，用完才釋放
+struct recog_model
+{
+    lbph_engine engine;
+    cv::Ptr<cv::face::LBPHFaceRecognizer> recognizer;   // 二進位模型時是空的
+
+    bool empty() const { return engine.empty() && (!recognizer || recognizer->empty()); }
+
+    // 最近的 k 個不同的人。predict 是 const，多個 thread 可以共用同一個模型
+    void predict_topk(const cv::Mat &face, int k, lbph_topk &top) const
+    {
+        if (!engine.empty()) {
+            engine.predict_topk(face, k, top);
+            return;
+        }
+        // OpenCV 的 StandardCollector 照樣本順序收集 threshold 以下的距離
+        cv::Ptr<cv::face::StandardCollector> collector = cv::face::StandardCollector::create(recognizer->getThreshold());
+        recognizer->predict(face, collector);
+        std::vector<std::pair<int, double> > results = collector->getResults(false);
+        top.reset(k);
+        for (size_t i = 0; i < results.size(); ++i) top.add(results[i].first, results[i].second, (int)i);
+    }
+};
+
+// 讀不到只警告，回傳 nullptr
+inline std::shared_ptr<recog_model> load_recog_model(const std::string &model_path)
+{
+    std::shared_ptr<recog_model> m = std::make_shared<recog_model>();
+    if (lbph_is_binary_model(model_path)) {
+        if (!m->engine.load(model_path)) {
+            std::cerr << "Warning: Could not load LBPH model (" << m->engine.last_error()
+                      << "). Recognition will be skipped." << std::endl;
+            return nullptr;
+        }
+        return m;
+    }
+    m->recognizer = cv::face::LBPHFaceRecognizer::create();
+    try {
+        m->recognizer->read(model_path);
+    } catch (...) {
+        std::cerr << "Warning: Could not load LBPH model. Recognition will be skipped." << std::endl;
+        return nullptr;
+    }
+    return m;
+}
+
+class face_pipeline
+{
+public:
+    face_pipeline(const pipeline_config &config, stage_stats &st)
+        : cfg(config), stats(st), model_generation(0),
+          gate(config.motion), tracker(config.track), assoc(config.assoc), recog_cache(config.recog),
+          enroller(config.enroll),
+          frames_since_detect(0),
+          frames_since_full_scan(0), pyr(buffers) {}
+
+    // Haar 和 LBP 的 cascade XML 都可以，CascadeClassifier 會自己看 featureType
+    bool load_cascade()
+    {
+        if (!face_cascade.load(cfg.cascade_path)) {
+            std::cerr << "Error: Cannot load cascade classifier " << cfg.cascade_path << std::endl;
+            return false;
+        }
+        if (cfg.native_detector && !native_cascade.load(cfg.cascade_path)) {
+            std::cerr << "Error: Native detector cannot use " << cfg.cascade_path << std::endl;
+            return false;
+        }
+        band_detectors.clear();
+        if (cfg.detect_threads > 1 && (!pool || pool->size() != cfg.detect_threads)) {
+            make_pool(pool, cfg.detect_threads);
+        }
+        return true;
+    }
+
+    // 0 = Haar, 1 = LBP (cv::FeatureEvaluator::HAAR / LBP)
+    const char *cascade_type() const
+    {
+        switch (face_cascade.getFeatureType()) {
+        case 0: return "haar";
+        case 1: return "lbp";
+        default: return "other";
+        }
+    }
+
+    // 換偵測參數 (benchmark 掃參數用)，cascade 路徑沒變就不重新載入
+    bool reconfigure(const pipeline_config &config)
+    {
+        bool reload = (config.cascade_path != cfg.cascade_path) || face_cascade.empty() ||
+                      (config.native_detector && native_cascade.empty()) ||
+                      (config.detect_threads > 1 && (!pool || pool->size() != config.detect_threads));
+        cfg = config;
+        gate = motion_gate(cfg.motion);
+        tracker = face_tracker(cfg.track);
+        assoc = track_associator(cfg.assoc);
+        recog_cache = recognition_cache(cfg.recog);
+        enroller = face_enroller(cfg.enroll);
+        frames_since_detect = 0;
+        frames_since_full_scan = 0;
+        last_small_faces.clear();
+        return reload ? load_cascade() : true;
+    }
+
+    // 模型讀不到時只警告，之後只做偵測
+    void load_model(const std::string &model_path)
+    {
+        if (cfg.recognize_threads > 1 && (!recog_pool || recog_pool->size() != cfg.recognize_threads)) {
+            make_pool(recog_pool, cfg.recognize_threads);
+        }
+        model = load_recog_model(model_path);
+        model_file = model_path;
+    }
+
+    // 熱更新：模型檔或 cascade 檔被換掉時在背景 thread 載入新版，
+    // 載入好的放進 pending，下一張 frame 開始時 (process 的開頭) 才換上，這張 frame 不受影響。
+    // 要在 load_cascade、load_model 之後呼叫
+    bool enable_hot_reload()
+    {
+        const std::string model_path = model_file, cascade_path = cfg.cascade_path;
+        const bool native = cfg.native_detector;
+        const int bands = (cfg.detect_threads > 1 && pool) ? pool->size() * 2 : 0;
+        bool ok = true;
+        if (!model_path.empty()) {
+            ok = watcher.watch(model_path, [this, model_path]() {
+                std::shared_ptr<recog_model> m = load_recog_model(model_path);
+                if (!m) return;     // 讀不到就繼續用舊的
+                std::atomic_store(&pending_model, m);
+                std::cerr << "Reloaded model " << model_path << std::endl;
+            }) && ok;
+        }
+        ok = watcher.watch(cascade_path, [this, cascade_path, native, bands]() {
+            std::shared_ptr<cascade_set> c = load_cascade_set(cascade_path, native, bands);
+            if (!c) return;
+            std::atomic_store(&pending_cascade, c);
+            std::cerr << "Reloaded cascade " << cascade_path << std::endl;
+        }) && ok;
+        if (!ok) {
+            std::cerr << "Warning: inotify is not available, hot reload disabled" << std::endl;
+            return false;
+        }
+        watcher.start();
+        return true;
+    }
+
+    void process(const cv::Mat &frame, std::vector<face_result> &results)
+    {
+        swap_reloaded();
+        std::vector<cv::Rect> faces;
+        detect_faces(frame, faces);
+
+        results.clear();
+        stats.begin(STAGE_RECOGNIZE);
+        // 要 predict 的臉先切好 (pyramid 是 lazy 的，只能一個 thread 碰)
+        std::vector<size_t> todo;
+        for (size_t i = 0; i < faces.size(); ++i) {
+            const cv::Rect &face = faces[i];
+            face_result r;
+            r.box = face;
+            r.id = face_ids[i];
+            r.label = -1;
+            r.confidence = 0.0;
+            results.push_back(r);
+            if (!has_model() || !recog_cache.need_predict(r.id, face)) continue;
+            if (crops.size() <= todo.size()) crops.resize(todo.size() + 1);
+            face_crop(face, crops[todo.size()]);
+            todo.push_back(i);
+        }
+
+        // 進行辨識：predict 是 const，多個 thread 可以共用同一個模型
+        const recog_model *m = model.get();
+        auto predict_one = [&](int k) {
+            face_result &r = results[todo[k]];
+            lbph_topk top;
+            m->predict_topk(crops[k], cfg.top_k, top);
+            int pick = cfg.open_set.decide(top);
+            r.label = pick >= 0 ? top[pick].label : -1;
+            r.confidence = top.size() ? top[pick >= 0 ? pick : 0].dist : DBL_MAX;
+        };
+        if (recog_pool && todo.size() > 1) {
+            recog_pool->parallel_for((int)todo.size(), predict_one);
+        } else {
+            for (size_t k = 0; k < todo.size(); ++k) predict_one((int)k);
+        }
+
+        if (recog_cache.enabled()) {
+            for (size_t k = 0; k < todo.size(); ++k) {
+                const face_result &r = results[todo[k]];
+                recog_cache.add(r.id, r.box, r.label, r.confidence);
+            }
+            if (has_model()) {
+                for (auto &r : results) recog_cache.result(r.id, r.label, r.confidence);
+            }
+        }
+        recog_cache.end_frame();
+        if (enroller.active()) enroll_step(results);
+        stats.end(STAGE_RECOGNIZE);
+    }
+
+    // 線上註冊 label / name 這個人 (只有 lbph_engine 的二進位模型可以)，samples <= 0 用 config 的張數。
+    // 之後每張 frame 在 process 裡收臉，收滿就加進模型並 append 到模型旁邊的 journal
+    bool start_enroll(int label, const std::string &name, int samples = 0)
+    {
+        if (!model || model->engine.empty()) {
+            std::cerr << "Warning: Enrollment needs a binary model (lbph_convert or lbph_train --binary)" << std::endl;
+            return false;
+        }
+        enroller.start(label, name, samples);
+        return true;
+    }
+
+    void cancel_enroll() { enroller.stop(); }
+    const face_enroller &enrollment() const { return enroller; }
+    // 有沒有辨識模型 (沒有時只做偵測，label 都是 -1)
+    bool has_model() const { return model && !model->empty(); }
+    // 模型換過 (熱更新) 就會變，名字要重新拿
+    int model_version() const { return model_generation; }
+
+    // 二進位模型 (YAML 模型或沒有模型時是空的)，拿 label 的名字、新的 label 用
+    const lbph_engine &binary_model() const
+    {
+        static const lbph_engine none;
+        return model ? model->engine : none;
+    }
+
+    // 線上註冊的樣本合併進模型檔 (journal 清掉)
+    bool save_model(const std::string &path)
+    {
+        if (!model || !model->engine.save(path)) {
+            std::cerr << "Error: Cannot save model (" << (model ? model->engine.last_error() : "no model") << ")" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // gray + 縮小 (同一次掃描) → equalize 縮小圖 → detect，回傳原始 frame 座標的框
+    void detect_faces(const cv::Mat &frame, std::vector<cv::Rect> &faces)
+    {
+        stats.begin(STAGE_GRAY);
+        pre.sweep(frame, cfg.small_scale, gray);
+        pyr.reset(gray, pre.half_image(), frame.channels() == 3 ? frame : cv::Mat());
+        stats.end(STAGE_GRAY);
+
+        stats.begin(STAGE_RESIZE);
+        pre.equalize_small(small_gray);
+        stats.end(STAGE_RESIZE);
+
+        faces.clear();
+
+        // tracker 模式：還沒到 detect_interval 而且每個 track 都可信，就不跑 cascade
+        bool predicted = false;
+        if (cfg.tracker && tracker.size() > 0 && frames_since_detect + 1 < cfg.track.detect_interval) {
+            stats.begin(STAGE_TRACK);
+            bool confident = tracker.predict(small_gray);
+            stats.end(STAGE_TRACK);
+            predicted = true;
+            if (confident) {
+                frames_since_detect++;
+                tracker.boxes(faces);
+                associate(faces);
+                return;
+            }
+        }
+
+        cv::Size minSize(gray.cols / 20, gray.rows / 20);
+        cv::Size maxSize(gray.cols / 2, gray.rows / 2);
+
+        motion_gate::decision d = motion_gate::FULL;
+        if (cfg.motion_gate) {
+            stats.begin(STAGE_MOTION);
+            cv::Size win = face_cascade.getOriginalWindowSize();
+            d = gate.update(small_gray, cv::Size(std::max(minSize.width, win.width), std::max(minSize.height, win.height)),
+                            motion_regions);
+            stats.end(STAGE_MOTION);
+        }
+
+        stats.begin(STAGE_DETECT);
+        if (d == motion_gate::FULL) {
+            if (cfg.roi_redetect && !last_small_faces.empty() && frames_since_full_scan + 1 < cfg.roi_full_interval) {
+                detect_around(last_small_faces, faces, minSize, maxSize);
+                frames_since_full_scan++;
+            } else {
+                run_detector(small_gray, faces, minSize, maxSize);
+                frames_since_full_scan = 0;
+            }
+        } else if (d == motion_gate::REGIONS) {
+            std::vector<cv::Rect> found;
+            for (const auto &region : motion_regions) {
+                run_detector(small_gray(region), found, minSize, maxSize);
+                for (auto &f : found) {
+                    faces.push_back(f + region.tl());
+                }
+            }
+            // 沒動的地方沿用上一張的結果 (站著不動的人)
+            for (const auto &prev : last_small_faces) {
+                bool moved = false;
+                for (const auto &region : motion_regions) {
+                    if ((prev & region).area() > 0) { moved = true; break; }
+                }
+                if (!moved) faces.push_back(prev);
+            }
+        } else {
+            faces = last_small_faces;   // 整個畫面沒動，直接沿用
+        }
+        stats.end(STAGE_DETECT);
+
+        if (cfg.tracker) {
+            stats.begin(STAGE_TRACK);
+            tracker.correct(small_gray, faces, predicted);
+            tracker.boxes(faces);
+            stats.end(STAGE_TRACK);
+            frames_since_detect = 0;
+        }
+        associate(faces);
+    }
+
+    // 沒有 equalize 的全尺寸灰階 (要 equalize 過的用 equalize_crop)
+    const cv::Mat &gray_image() const { return gray; }
+    void equalize_crop(const cv::Mat &src, cv::Mat &dst) const { pre.equalize(src, dst); }
+    // 這張 frame 的 pyramid (顯示的縮圖也從這裡拿) 和它借記憶體的 pool
+    frame_pyramid &pyramid() { return pyr; }
+    mat_pool &buffers_pool() { return buffers; }
+    const std::vector<cv::Rect> &last_motion_regions() const { return motion_regions; }
+    // 和 detect_faces 回傳的框一一對應
+    const std::vector<int> &last_face_ids() const { return face_ids; }
+    const pipeline_config &config() const { return cfg; }
+
+private:
+    // 換 pool 時 perf 計數器也跟著換成新的 thread (stage_stats 只算登記過的 thread)
+    void make_pool(std::unique_ptr<work_pool> &p, int threads)
+    {
+        if (p) stats.remove_threads(p->thread_ids());
+        p.reset(new work_pool(threads));
+        stats.add_threads(p->thread_ids());
+    }
+
+    // 背景載入好的模型 / cascade 換上來。舊的模型這張 frame 已經沒人用，在這裡釋放
+    void swap_reloaded()
+    {
+        std::shared_ptr<recog_model> m = std::atomic_exchange(&pending_model, std::shared_ptr<recog_model>());
+        if (m) {
+            model = m;
+            model_generation++;
+            recog_cache.reset();    // 舊模型的投票不算數
+        }
+        std::shared_ptr<cascade_set> c = std::atomic_exchange(&pending_cascade, std::shared_ptr<cascade_set>());
+        if (c) {
+            face_cascade = c->cascade;
+            native_cascade = std::move(c->native);
+            band_detectors = std::move(c->bands);
+        }
+    }
+
+    // 辨識 / 註冊用的 100x100 臉。預設和 lbph_train 一樣：全尺寸切 → equalize → INTER_LINEAR resize。
+    // pyramid_crops 時從 pyramid 比較小的層切，equalize 和 resize 都少做，
+    // 但那一層是 2x 平均過的，LBPH 看到的臉和訓練時不完全一樣
+    void face_crop(const cv::Rect &box, cv::Mat &dst)
+    {
+        const cv::Size face_size(100, 100);
+        pre.equalize(cfg.pyramid_crops ? pyr.crop_source(box, face_size) : gray(box), dst);
+        cv::resize(dst, dst, face_size);
+    }
+
+    // 收這張 frame 裡鎖定的那張臉，收滿就一次加進模型
+    void enroll_step(const std::vector<face_result> &results)
+    {
+        std::vector<int> ids;
+        std::vector<cv::Rect> boxes;
+        for (const auto &r : results) {
+            ids.push_back(r.id);
+            boxes.push_back(r.box);
+        }
+        int k = enroller.select(ids, boxes);
+        if (enroller.lost_target()) {
+            std::cerr << "Warning: Enrollment of " << enroller.name() << " cancelled, face lost" << std::endl;
+            enroller.stop();
+            return;
+        }
+        if (k < 0) return;
+        cv::Mat crop;
+        face_crop(results[k].box, crop);
+        if (!enroller.add(crop)) return;
+
+        lbph_engine &engine = model->engine;
+        if (engine.enroll(enroller.crops(), enroller.label(), enroller.name())) {
+            std::cerr << "Enrolled " << enroller.name() << " as label " << enroller.label()
+                      << " (" << enroller.collected() << " faces, " << engine.count() << " samples)" << std::endl;
+            recog_cache.reset();    // 已經在畫面上的 track 重新 predict
+        } else {
+            std::cerr << "Error: Enrollment failed (" << engine.last_error() << ")" << std::endl;
+        }
+        enroller.stop();
+    }
+
+    // 不管框是偵測還是 tracker 來的，最後都在這裡給 ID (和平滑)，再換回原始 frame 座標
+    void associate(std::vector<cv::Rect> &faces)
+    {
+        std::vector<cv::Rect> raw;
+        raw.swap(faces);
+        stats.begin(STAGE_TRACK);
+        assoc.update(raw, faces, face_ids);
+        stats.end(STAGE_TRACK);
+        last_small_faces = faces;
+        to_frame_coords(faces);
+    }
+
+    // small_gray 座標 → 原始 frame 座標
+    void to_frame_coords(std::vector<cv::Rect> &faces) const
+    {
+        const double small_scale = cfg.small_scale;
+        for (auto &face : faces) {
+            face.x = cvRound(face.x * small_scale);
+            face.y = cvRound(face.y * small_scale);
+            face.width = cvRound(face.width * small_scale);
+            face.height = cvRound(face.height * small_scale);
+            face &= cv::Rect(0, 0, gray.cols, gray.rows);
+        }
+    }
+
+    // 只在上一張每個框的附近找，而且只找大小差不多的臉 (pyramid 只剩幾層)
+    void detect_around(const std::vector<cv::Rect> &prev, std::vector<cv::Rect> &out,
+                       cv::Size minSize, cv::Size maxSize)
+    {
+        const cv::Rect bounds(0, 0, small_gray.cols, small_gray.rows);
+        std::vector<cv::Rect> found;
+        for (const auto &p : prev) {
+            int mx = cvRound(p.width * cfg.roi_margin);
+            int my = cvRound(p.height * cfg.roi_margin);
+            cv::Rect window = cv::Rect(p.x - mx, p.y - my, p.width + 2 * mx, p.height + 2 * my) & bounds;
+            cv::Size lo(std::max(minSize.width, cvRound(p.width * cfg.roi_min_ratio)),
+                        std::max(minSize.height, cvRound(p.height * cfg.roi_min_ratio)));
+            cv::Size hi(std::min(maxSize.width, cvRound(p.width * cfg.roi_max_ratio)),
+                        std::min(maxSize.height, cvRound(p.height * cfg.roi_max_ratio)));
+            if (window.width < lo.width || window.height < lo.height || hi.width < lo.width || hi.height < lo.height) {
+                continue;
+            }
+            run_detector(small_gray(window), found, lo, hi);
+            for (const auto &f : found) {
+                cv::Rect r = f + window.tl();
+                // 兩個人靠很近時搜尋範圍會重疊，同一張臉只留一次
+                bool duplicate = false;
+                for (const auto &o : out) {
+                    if ((o & r).area() * 2 > std::min(o.area(), r.area())) { duplicate = true; break; }
+                }
+                if (!duplicate) out.push_back(r);
+            }
+        }
+    }
+
+    void run_detector(const cv::Mat &img, std::vector<cv::Rect> &out, cv::Size minSize, cv::Size maxSize)
+    {
+        if (cfg.detect_threads > 1 && pool) {
+            parallel_detect(img, out, minSize, maxSize);
+        } else if (cfg.native_detector) {
+            native_cascade.detect(img, out, cfg.scale_factor, cfg.min_neighbors, minSize, maxSize);
+        } else {
+            face_cascade.detectMultiScale(
+                img, out,
+                cfg.scale_factor, cfg.min_neighbors, 0, minSize, maxSize
+            );
+        }
+    }
+
+    // CascadeClassifier 同時只能給一個 thread 用，每一段各自有一份
+    struct band_detector
+    {
+        cv::CascadeClassifier cascade;
+        haar_fixed_cascade native;
+        std::vector<cv::Rect> hits;
+    };
+
+    // 熱更新時背景 thread 整組載入好的 cascade (bands 是 parallel_detect 每段各自的一份)
+    struct cascade_set
+    {
+        cv::CascadeClassifier cascade;
+        haar_fixed_cascade native;
+        std::vector<std::unique_ptr<band_detector> > bands;
+    };
+
+    static std::shared_ptr<cascade_set> load_cascade_set(const std::string &path, bool native, int bands)
+    {
+        std::shared_ptr<cascade_set> c = std::make_shared<cascade_set>();
+        bool ok = c->cascade.load(path) && (!native || c->native.load(path));
+        for (int b = 0; ok && b < bands; ++b) {
+            std::unique_ptr<band_detector> d(new band_detector);
+            ok = native ? d->native.load(path) : d->cascade.load(path);
+            c->bands.push_back(std::move(d));
+        }
+        if (!ok) {
+            std::cerr << "Warning: Cannot reload cascade classifier " << path << ", keeping the old one" << std::endl;
+            return nullptr;
+        }
+        return c;
+    }
+
+    // pyramid 的層依照計算量切成幾段，每段在 work_pool 上用 minNeighbors = 0 拿到沒合併的框，
+    // 全部合起來再 groupRectangles，和單一個 detectMultiScale 的結果相同
+    void parallel_detect(const cv::Mat &img, std::vector<cv::Rect> &out, cv::Size minSize, cv::Size maxSize)
+    {
+        std::vector<cv::Size> lo, hi;
+        split_scale_bands(img.size(), minSize, maxSize, pool->size() * 2, lo, hi);
+        while (band_detectors.size() < lo.size()) {
+            std::unique_ptr<band_detector> d(new band_detector);
+            bool ok = cfg.native_detector ? d->native.load(cfg.cascade_path) : d->cascade.load(cfg.cascade_path);
+            if (!ok) {
+                std::cerr << "Error: Cannot load cascade classifier " << cfg.cascade_path << std::endl;
+                out.clear();
+                return;
+            }
+            band_detectors.push_back(std::move(d));
+        }
+
+        pool->parallel_for((int)lo.size(), [&](int b) {
+            band_detector &d = *band_detectors[b];
+            if (cfg.native_detector) {
+                d.native.detect(img, d.hits, cfg.scale_factor, 0, lo[b], hi[b]);
+            } else {
+                d.cascade.detectMultiScale(img, d.hits, cfg.scale_factor, 0, 0, lo[b], hi[b]);
+            }
+        });
+
+        out.clear();
+        for (size_t b = 0; b < lo.size(); ++b) {
+            out.insert(out.end(), band_detectors[b]->hits.begin(), band_detectors[b]->hits.end());
+        }
+        cv::groupRectangles(out, cfg.min_neighbors, 0.2);
+    }
+
+    // 用和 detectMultiScale 一樣的方式列出每一層的 window 大小，估計每層的計算量
+    // (縮小後的面積 / step^2)，切成 bands 段；每段以 [lo, hi] 的 window 大小傳給偵測器
+    void split_scale_bands(cv::Size img, cv::Size minSize, cv::Size maxSize, int bands,
+                           std::vector<cv::Size> &lo, std::vector<cv::Size> &hi) const
+    {
+        lo.clear();
+        hi.clear();
+        cv::Size win0 = face_cascade.getOriginalWindowSize();
+        cv::Size limit = (maxSize.width == 0 || maxSize.height == 0) ? img : maxSize;
+        std::vector<cv::Size> levels;
+        std::vector<double> cost;
+        double total = 0.0;
+        for (double factor = 1.0; ; factor *= cfg.scale_factor) {
+            cv::Size win(cvRound(win0.width * factor), cvRound(win0.height * factor));
+            cv::Size scaled(cvRound(img.width / factor), cvRound(img.height / factor));
+            if (scaled.width <= win0.width || scaled.height <= win0.height) break;
+            if (win.width > limit.width || win.height > limit.height) break;
+            if (win.width < minSize.width || win.height < minSize.height) continue;
+            int step = factor > 2.0 ? 1 : 2;
+            levels.push_back(win);
+            cost.push_back((double)scaled.area() / (step * step));
+            total += cost.back();
+        }
+        if (levels.empty()) {
+            lo.push_back(minSize);
+            hi.push_back(maxSize);
+            return;
+        }
+
+        double acc = 0.0;
+        size_t first = 0;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            acc += cost[i];
+            bool last = (i + 1 == levels.size());
+            // 相鄰兩層 window 一樣大時不能從中間切，不然同一層會跑兩次
+            bool cut = !last && levels[i] != levels[i + 1] &&
+                       acc >= total * (lo.size() + 1) / bands;
+            if (cut || last) {
+                lo.push_back(levels[first]);
+                hi.push_back(levels[i]);
+                first = i + 1;
+            }
+        }
+        // 頭尾用原本的範圍，最外面的層怎麼判斷都交給偵測器自己
+        lo.front() = minSize;
+        hi.back() = maxSize;
+    }
+
+    pipeline_config cfg;
+    stage_stats &stats;
+    cv::CascadeClassifier face_cascade;
+    haar_fixed_cascade native_cascade;
+    std::shared_ptr<recog_model> model;             // 只有 process 的 thread 碰
+    std::string model_file;
+    int model_generation;                           // 換過幾次模型
+    std::shared_ptr<recog_model> pending_model;     // 熱更新：背景 thread 用 std::atomic_store 放進來
+    std::shared_ptr<cascade_set> pending_cascade;
+    file_watcher watcher;
+
+    frame_preprocessor pre;
+    cv::Mat gray;           // 全尺寸，沒有 equalize
+    cv::Mat small_gray;     // 縮小 + equalize，給偵測用
+
+    motion_gate gate;
+    std::vector<cv::Rect> motion_regions;
+    std::vector<cv::Rect> last_small_faces;     // small_gray 座標
+
+    std::unique_ptr<work_pool> pool;
+    std::vector<std::unique_ptr<band_detector> > band_detectors;
+
+    face_tracker tracker;
+    track_associator assoc;
+    recognition_cache recog_cache;
+    std::unique_ptr<work_pool> recog_pool;
+    std::vector<cv::Mat> crops;     // 這張 frame 要 predict 的 100x100 臉
+    face_enroller enroller;         // 線上註冊收臉
+    int frames_since_detect;
+    int frames_since_full_scan;
+    std::vector<int> face_ids;
+
+    mat_pool buffers;
+    frame_pyramid pyr;
+};
+
+#endif // FACE_PIPELINE_H
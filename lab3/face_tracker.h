@@ -0,0 +1,249 @@
+#ifndef FACE_TRACKER_H
+#define FACE_TRACKER_H
+
+// 兩次偵測之間用 MOSSE correlation filter (Bolme et al., CVPR 2010) 追蹤每張臉
+// 每個 track 把框的兩倍大小縮成 64x64 的 patch，在頻域學一個 filter H，
+// 讓 patch 和 H 的 correlation 在目標中心出現一個 gaussian 尖峰；
+// 下一張在同位置取 patch 做 correlation，尖峰偏移多少框就移多少。
+// 尖峰的 PSR (peak-to-sidelobe ratio) 當作可信度，太低就要求重新偵測。
+// MOSSE 不處理尺度變化，框的大小由每 detect_interval 張一次的偵測來修正。
+
+#include <cmath>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "track_assoc.h"
+
+struct tracker_config
+{
+    int detect_interval = 10;       // 每幾張跑一次 cascade
+    double min_psr = 8.0;           // PSR 低於這個值就提早重新偵測
+    double learning_rate = 0.125;   // filter 的更新速度
+    double min_iou = 0.3;           // 偵測框和 filter 的 IoU 超過這個值才沿用同一個 filter
+    int max_misses = 1;             // 偵測沒找到時 track 最多再撐幾輪偵測 (減少框閃爍)
+};
+
+class mosse_tracker
+{
+public:
+    static const int patch_size = 64;
+
+    void init(const cv::Mat &gray, const cv::Rect &box, double rate)
+    {
+        learning_rate = rate;
+        center = cv::Point2f(box.x + box.width * 0.5f, box.y + box.height * 0.5f);
+        size = box.size();
+        if (window.empty()) {
+            cv::createHanningWindow(window, cv::Size(patch_size, patch_size), CV_32F);
+            make_target();
+        }
+
+        // 只用一張 patch 訓練 filter 會不穩，加幾張小角度旋轉、縮放的版本
+        cv::Mat patch, F, a, b;
+        A = cv::Mat::zeros(patch_size, patch_size, CV_32FC2);
+        B = cv::Mat::zeros(patch_size, patch_size, CV_32FC2);
+        cv::RNG rng(0x6d6f7373);
+        for (int i = 0; i < 8; ++i) {
+            double angle = i == 0 ? 0.0 : rng.uniform(-0.1, 0.1);
+            double scale = i == 0 ? 1.0 : rng.uniform(0.9, 1.1);
+            extract(gray, patch, angle, scale);
+            cv::dft(patch, F, cv::DFT_COMPLEX_OUTPUT);
+            cv::mulSpectrums(G, F, a, 0, true);
+            cv::mulSpectrums(F, F, b, 0, true);
+            A += a;
+            B += b;
+        }
+        update_filter();
+    }
+
+    // 回傳 PSR，同時把框移到新的位置
+    double update(const cv::Mat &gray)
+    {
+        cv::Mat patch, F, R, response;
+        extract(gray, patch, 0.0, 1.0);
+        cv::dft(patch, F, cv::DFT_COMPLEX_OUTPUT);
+        cv::mulSpectrums(F, H, R, 0, false);
+        cv::idft(R, response, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        double peak;
+        cv::Point loc;
+        cv::minMaxLoc(response, nullptr, &peak, nullptr, &loc);
+        double psr = peak_to_sidelobe(response, loc, peak);
+
+        // patch 的 1 pixel = 原圖的 2 * size / patch_size pixel
+        center.x += (loc.x - patch_size / 2) * 2.0f * size.width / patch_size;
+        center.y += (loc.y - patch_size / 2) * 2.0f * size.height / patch_size;
+        center.x = std::min(std::max(center.x, 0.0f), (float)gray.cols - 1);
+        center.y = std::min(std::max(center.y, 0.0f), (float)gray.rows - 1);
+
+        // 在新位置重新取 patch 更新 filter (running average)
+        cv::Mat a, b;
+        extract(gray, patch, 0.0, 1.0);
+        cv::dft(patch, F, cv::DFT_COMPLEX_OUTPUT);
+        cv::mulSpectrums(G, F, a, 0, true);
+        cv::mulSpectrums(F, F, b, 0, true);
+        A = A * (1.0 - learning_rate) + a * learning_rate;
+        B = B * (1.0 - learning_rate) + b * learning_rate;
+        update_filter();
+        return psr;
+    }
+
+    cv::Rect box() const
+    {
+        return cv::Rect(cvRound(center.x - size.width * 0.5f), cvRound(center.y - size.height * 0.5f),
+                        size.width, size.height);
+    }
+
+private:
+    // 以 center 為中心取 2 倍框大小的區域，縮到 patch_size，再做 MOSSE 的前處理
+    void extract(const cv::Mat &gray, cv::Mat &out, double angle, double scale)
+    {
+        double sx = patch_size / (2.0 * size.width) * scale;
+        double sy = patch_size / (2.0 * size.height) * scale;
+        double c = std::cos(angle), s = std::sin(angle);
+        cv::Mat M = (cv::Mat_<double>(2, 3) <<
+                     c * sx, -s * sx, patch_size * 0.5 - (c * center.x - s * center.y) * sx,
+                     s * sy,  c * sy, patch_size * 0.5 - (s * center.x + c * center.y) * sy);
+        cv::warpAffine(gray, raw, M, cv::Size(patch_size, patch_size), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+        raw.convertTo(out, CV_32F, 1.0, 1.0);
+        cv::log(out, out);
+        cv::Scalar mean, stddev;
+        cv::meanStdDev(out, mean, stddev);
+        out = (out - mean[0]) / (stddev[0] + 1e-5);
+        out = out.mul(window);
+    }
+
+    void make_target()
+    {
+        const double sigma = 2.0;
+        cv::Mat g(patch_size, patch_size, CV_32F);
+        for (int y = 0; y < patch_size; ++y) {
+            float *row = g.ptr<float>(y);
+            for (int x = 0; x < patch_size; ++x) {
+                double dx = x - patch_size / 2, dy = y - patch_size / 2;
+                row[x] = (float)std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+            }
+        }
+        cv::dft(g, G, cv::DFT_COMPLEX_OUTPUT);
+    }
+
+    // H = A / B，B = |F|^2 是實數，實部虛部各除一次
+    void update_filter()
+    {
+        cv::Mat ch[2], b[2];
+        cv::split(A, ch);
+        cv::split(B, b);
+        b[0] += 1e-3;
+        cv::divide(ch[0], b[0], ch[0]);
+        cv::divide(ch[1], b[0], ch[1]);
+        cv::merge(ch, 2, H);
+    }
+
+    // 尖峰周圍 11x11 以外的區域當 sidelobe
+    static double peak_to_sidelobe(const cv::Mat &response, cv::Point loc, double peak)
+    {
+        cv::Mat mask(response.size(), CV_8U, cv::Scalar(255));
+        cv::rectangle(mask, cv::Rect(loc.x - 5, loc.y - 5, 11, 11), cv::Scalar(0), cv::FILLED);
+        cv::Scalar mean, stddev;
+        cv::meanStdDev(response, mean, stddev, mask);
+        return (peak - mean[0]) / (stddev[0] + 1e-5);
+    }
+
+    double learning_rate = 0.125;
+    cv::Point2f center;
+    cv::Size size;
+    cv::Mat window;     // hanning window
+    cv::Mat G;          // 目標 gaussian 的頻譜
+    cv::Mat A, B, H;
+    cv::Mat raw;
+};
+
+// 多張臉的 filter 管理：偵測的 frame 用偵測框重新初始化 filter，其他 frame 只跑 filter。
+// 臉的 ID 由 track_assoc.h 統一給，這裡不管
+class face_tracker
+{
+public:
+    struct track
+    {
+        cv::Rect box;
+        double psr;
+        int misses;
+        mosse_tracker filter;
+    };
+
+    explicit face_tracker(const tracker_config &config = tracker_config())
+        : cfg(config) {}
+
+    // 沒有偵測的 frame：每個 track 跑一次 filter，全部都可信才回傳 true
+    bool predict(const cv::Mat &gray)
+    {
+        bool confident = true;
+        for (auto &t : tracks) {
+            t.psr = t.filter.update(gray);
+            t.box = t.filter.box();
+            if (t.psr < cfg.min_psr) confident = false;
+        }
+        return confident;
+    }
+
+    // 偵測的 frame：對到的 track 用偵測框重新初始化 filter，沒對到的偵測開新的 track，
+    // 沒對到的 track 如果 filter 還可信就再留 max_misses 輪。
+    // predicted: 這張 frame 已經先跑過 predict (PSR 太低才改跑偵測)
+    void correct(const cv::Mat &gray, const std::vector<cv::Rect> &detections, bool predicted)
+    {
+        std::vector<bool> used(tracks.size(), false);
+        std::vector<track> next;
+        for (const auto &d : detections) {
+            int best = -1;
+            double best_iou = cfg.min_iou;
+            for (size_t i = 0; i < tracks.size(); ++i) {
+                if (used[i]) continue;
+                double v = box_iou(tracks[i].box, d);
+                if (v >= best_iou) {
+                    best_iou = v;
+                    best = (int)i;
+                }
+            }
+            track t;
+            if (best >= 0) {
+                used[best] = true;
+                t = tracks[best];
+            }
+            t.box = d;
+            t.misses = 0;
+            t.filter.init(gray, d, cfg.learning_rate);
+            t.psr = 0.0;
+            next.push_back(t);
+        }
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            if (used[i]) continue;
+            track &t = tracks[i];
+            if (!predicted) {
+                t.psr = t.filter.update(gray);
+                t.box = t.filter.box();
+            }
+            if (t.psr >= cfg.min_psr && t.misses < cfg.max_misses) {
+                t.misses++;
+                next.push_back(t);
+            }
+        }
+        tracks.swap(next);
+    }
+
+    void boxes(std::vector<cv::Rect> &out) const
+    {
+        out.clear();
+        for (const auto &t : tracks) out.push_back(t.box);
+    }
+
+    size_t size() const { return tracks.size(); }
+    void reset() { tracks.clear(); }
+
+private:
+    tracker_config cfg;
+    std::vector<track> tracks;
+};
+
+#endif // FACE_TRACKER_H
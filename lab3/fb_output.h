@@ -0,0 +1,130 @@
+#ifndef FB_OUTPUT_H
+#define FB_OUTPUT_H
+
+// lab3-1 的顯示端：畫框和名字 → 等比例縮到 framebuffer 大小 → RGB565 → 寫進 framebuffer。
+// pipeline_bench 用記憶體當 framebuffer 跑同一份程式，compose / rgb565 / fb_write 也量得到。
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "face_pipeline.h"
+
+struct framebuffer_info
+{
+    uint32_t bits_per_pixel;    // depth of framebuffer
+    uint32_t xres_virtual;      // 記憶體中每一列實際保留的pixel數，包含為panning或其他所保留的空間
+    uint32_t yres_virtual;      // (visible resolution就沒有包含這些，所以通常較小)
+    uint32_t xres;
+    uint32_t yres;
+    uint32_t line_length;       // bytes per row in framebuffer (包含 padding)
+    size_t smem_len;            // total framebuffer memory len
+};
+
+// 在 frame 上畫出每張臉的框、ID、名字和信心值；註冊中的那張臉改畫收集進度
+inline void draw_faces(cv::Mat &frame, const std::vector<face_result> &faces, const face_enroller &enroll,
+                       const std::map<int, std::string> &names, bool has_model)
+{
+    for (const auto &f : faces) {
+        const cv::Rect &face = f.box;
+        if (enroll.active() && f.id == enroll.target_id()) {
+            // 註冊中的臉用黃色框，顯示收集進度
+            cv::rectangle(frame, face, cv::Scalar(0, 255, 255), 2);
+            cv::putText(frame, "Enrolling " + enroll.name() + " " + std::to_string(enroll.collected()) + "/" +
+                        std::to_string(enroll.samples()), cv::Point(face.x, face.y - 10),
+                        cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 255), 2);
+            continue;
+        }
+        cv::rectangle(frame, face, cv::Scalar(0, 255, 0), 2);
+
+        // 信心值 (距離) 越低越準確，Unknown 的門檻在 pipeline 的 open_set 判斷
+        std::string text;
+        if (f.label >= 0) {
+            auto it = names.find(f.label);
+            if (it != names.end()) text = it->second;
+        } else if (has_model) {
+            text = "Unknown";
+        }
+        if (f.id >= 0) {
+            text = "#" + std::to_string(f.id) + " " + text;
+        }
+
+        cv::putText(frame, text + ", confidence: " + std::to_string(f.confidence), cv::Point(face.x, face.y - 10),
+                    cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
+    }
+}
+
+// 等比例縮放到 framebuffer 大小，置中貼在黑底上
+// 有 pyramid 時從縮完還不小於目標大小的那一層開始縮，background 從 pool 借
+inline cv::Mat letterbox_to_fb(const cv::Mat &frame, int fb_width, int fb_height,
+                               frame_pyramid *pyr = nullptr, mat_pool *pool = nullptr)
+{
+    double scale_x = (double)fb_width / (double)frame.cols;
+    double scale_y = (double)fb_height / (double)frame.rows;
+    double scale = std::min(scale_x, scale_y);
+    if (scale <= 0) scale = 1.0;
+    int new_w = std::max(1, (int)std::round(frame.cols * scale));
+    int new_h = std::max(1, (int)std::round(frame.rows * scale));
+
+    cv::Mat display_frame;
+    if (new_w != frame.cols || new_h != frame.rows) {
+        cv::Mat src = frame;
+        if (pyr) {
+            int k = pyr->level_for(frame.size(), cv::Size(new_w, new_h));
+            while (k > 0 && pyr->color_level(k).empty()) --k;
+            if (k > 0) src = pyr->color_level(k);
+        }
+        cv::resize(src, display_frame, cv::Size(new_w, new_h), 0, 0, cv::INTER_AREA);
+    } else {
+        display_frame = frame;
+    }
+
+    cv::Mat background;
+    if (pool) {
+        background = pool->acquire(cv::Size(fb_width, fb_height), display_frame.type());
+        background.setTo(cv::Scalar::all(0));
+    } else {
+        background = cv::Mat::zeros(cv::Size(fb_width, fb_height), display_frame.type());
+    }
+    int x_offset = (fb_width - display_frame.cols) / 2;
+    int y_offset = (fb_height - display_frame.rows) / 2;
+    if (x_offset < 0) x_offset = 0;
+    if (y_offset < 0) y_offset = 0;
+    cv::Rect roi(x_offset, y_offset, display_frame.cols, display_frame.rows);
+    display_frame.copyTo(background(roi));
+    return background;
+}
+
+// BGR → RGB565 後逐列寫進 framebuffer
+inline void write_to_fb(const cv::Mat &background, const framebuffer_info &fb_info, uint8_t *fb_ptr, stage_stats &stats)
+{
+    const int fb_width = fb_info.xres;
+    const int fb_height = fb_info.yres;
+    const int fb_line_len = fb_info.line_length;
+    const size_t max_row_bytes = (size_t)fb_line_len;
+
+    stats.begin(STAGE_CONVERT);
+    cv::Mat converted_image;
+    cv::cvtColor(background, converted_image, cv::COLOR_BGR2BGR565);
+    stats.end(STAGE_CONVERT);
+    
+    stats.begin(STAGE_FB_WRITE);
+    size_t row_bytes = (size_t)fb_width * 2;
+    if (row_bytes > max_row_bytes) row_bytes = max_row_bytes; // safety
+
+    for (int y = 0; y < fb_height; ++y) {
+        uint8_t *dst_row = fb_ptr + (size_t)y * fb_line_len;
+        std::memset(dst_row, 0, fb_line_len);   // 清除整列 (包含 padding) 以避免殘留像素
+        const uint8_t *src_row = converted_image.ptr<uint8_t>(y);
+        std::memcpy(dst_row, src_row, row_bytes);
+    }
+    stats.end(STAGE_FB_WRITE);
+}
+
+#endif // FB_OUTPUT_H
@@ -0,0 +1,113 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+// 用 inotify 看檔案有沒有更新，有的話在背景 thread 呼叫 callback (熱更新模型、cascade 用)
+// 看的是檔案所在的資料夾，不是檔案本身：lbph_write_model、mv 這類「寫暫存檔再 rename」的更新
+// 會換掉 inode，直接看檔案的話 rename 之後就收不到事件了。
+// 同一個檔案的事件在 settle_ms 內沒有新的才呼叫一次 callback (避免 cp 寫到一半就去讀)。
+//
+// 注意：二進位模型是 mmap 的，不要用 cp 直接覆蓋正在用的模型檔 (檔案被截短時讀舊模型會 SIGBUS)，
+// 先 cp 到別的名字再 mv 過去。
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+class file_watcher
+{
+public:
+    explicit file_watcher(int settle_ms = 300) : fd(-1), settle(settle_ms), running(false) {}
+    ~file_watcher() { stop(); }
+
+    // start 之前呼叫。path 被寫完 (close_write) 或 rename 過來時在背景 thread 呼叫 on_change
+    bool watch(const std::string &path, const std::function<void()> &on_change)
+    {
+        if (fd < 0) fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) return false;
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+        if (dir.empty()) dir = "/";
+        int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) return false;
+        entry e;
+        e.wd = wd;
+        e.name = slash == std::string::npos ? path : path.substr(slash + 1);
+        e.on_change = on_change;
+        e.dirty = false;
+        entries.push_back(e);
+        return true;
+    }
+
+    void start()
+    {
+        if (running || fd < 0) return;
+        running = true;
+        worker = std::thread(&file_watcher::run, this);
+    }
+
+    void stop()
+    {
+        running = false;
+        if (worker.joinable()) worker.join();
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        entries.clear();
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct entry
+    {
+        int wd;
+        std::string name;
+        std::function<void()> on_change;
+        bool dirty;
+        clock::time_point last_event;
+    };
+
+    void run()
+    {
+        alignas(inotify_event) char buf[4096];
+        while (running) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 100) > 0) {
+                ssize_t n;
+                while ((n = read(fd, buf, sizeof(buf))) > 0) {
+                    for (char *p = buf; p < buf + n;) {
+                        const inotify_event *ev = (const inotify_event *)p;
+                        p += sizeof(inotify_event) + ev->len;
+                        if (ev->len == 0) continue;
+                        for (auto &e : entries) {
+                            if (e.wd == ev->wd && e.name == ev->name) {
+                                e.dirty = true;
+                                e.last_event = clock::now();
+                            }
+                        }
+                    }
+                }
+            }
+            for (auto &e : entries) {
+                if (e.dirty && clock::now() - e.last_event >= std::chrono::milliseconds(settle)) {
+                    e.dirty = false;
+                    e.on_change();
+                }
+            }
+        }
+    }
+
+    int fd;
+    int settle;
+    std::vector<entry> entries;     // start 之後只有背景 thread 碰
+    std::atomic<bool> running;
+    std::thread worker;
+};
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,507 @@
+#ifndef HAAR_FIXED_H
+#define HAAR_FIXED_H
+
+// 自己實作的 Haar cascade 偵測器，取代 cv::CascadeClassifier::detectMultiScale
+// (只支援 stump、沒有 tilted feature 的新格式 XML，例如 haarcascade_frontalface_default.xml)
+//
+// - integral / squared integral 用 NEON 或 SSE2 一次處理 8 個 pixel
+// - stage 全部用整數算：rect 加權和本來就是整數，feature threshold 存成 Q15，
+//   每個 window 乘上自己的 norm factor 再比較；leaf 和 stage threshold 存成 Q16
+// - 同一列上相鄰的 4 個 window 放進同一個 SIMD 向量的 4 個 lane 一起算，
+//   4 個 lane 都被某個 stage 淘汰才提早離開
+// - 縮放、window 間距、minSize/maxSize 和 groupRectangles 的規則都照 OpenCV，
+//   所以 minNeighbors 的意義不變
+//
+// 定義 HAAR_NO_SIMD 可以強制用純 C++ 版本 (拿來和 SIMD 版本對答案)
+// NEON 路徑還沒在板子上編譯、量過；和 detectMultiScale 的 recall / 速度要用 cascade_compare --native 比
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#if !defined(HAAR_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define HAAR_USE_NEON 1
+#elif !defined(HAAR_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define HAAR_USE_SSE2 1
+#endif
+
+// ---- 4 x int32 的向量運算 ----------------------------------------------------
+// integral image 是 uint32 且允許 overflow (squared integral 一定會 overflow)，
+// 只要相減的結果正確就好，所以全部用 two's complement 的加減
+
+#if defined(HAAR_USE_NEON)
+
+typedef int32x4_t hv4;
+static inline hv4 hv_load(const uint32_t *p, int step)
+{
+    return vreinterpretq_s32_u32(step == 1 ? vld1q_u32(p) : vld2q_u32(p).val[0]);
+}
+static inline hv4 hv_set1(int32_t v) { return vdupq_n_s32(v); }
+static inline hv4 hv_loadi(const int32_t *p) { return vld1q_s32(p); }
+static inline void hv_store(int32_t *p, hv4 a) { vst1q_s32(p, a); }
+static inline hv4 hv_add(hv4 a, hv4 b) { return vaddq_s32(a, b); }
+static inline hv4 hv_sub(hv4 a, hv4 b) { return vsubq_s32(a, b); }
+static inline hv4 hv_muls(hv4 a, int32_t s) { return vmulq_n_s32(a, s); }
+static inline hv4 hv_shr15(hv4 a) { return vshrq_n_s32(a, 15); }
+static inline hv4 hv_lt(hv4 a, hv4 b) { return vreinterpretq_s32_u32(vcltq_s32(a, b)); }
+static inline hv4 hv_ge(hv4 a, hv4 b) { return vreinterpretq_s32_u32(vcgeq_s32(a, b)); }
+static inline hv4 hv_and(hv4 a, hv4 b) { return vandq_s32(a, b); }
+static inline hv4 hv_select(hv4 m, hv4 a, hv4 b) { return vbslq_s32(vreinterpretq_u32_s32(m), a, b); }
+static inline bool hv_any(hv4 m)
+{
+    uint32x4_t u = vreinterpretq_u32_s32(m);
+    uint32x2_t t = vorr_u32(vget_low_u32(u), vget_high_u32(u));
+    return (vget_lane_u32(t, 0) | vget_lane_u32(t, 1)) != 0;
+}
+
+#elif defined(HAAR_USE_SSE2)
+
+typedef __m128i hv4;
+static inline hv4 hv_load(const uint32_t *p, int step)
+{
+    if (step == 1) return _mm_loadu_si128((const __m128i*)p);
+    __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)p));
+    __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(p + 4)));
+    return _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+static inline hv4 hv_set1(int32_t v) { return _mm_set1_epi32(v); }
+static inline hv4 hv_loadi(const int32_t *p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void hv_store(int32_t *p, hv4 a) { _mm_storeu_si128((__m128i*)p, a); }
+static inline hv4 hv_add(hv4 a, hv4 b) { return _mm_add_epi32(a, b); }
+static inline hv4 hv_sub(hv4 a, hv4 b) { return _mm_sub_epi32(a, b); }
+// SSE2 沒有 32-bit mullo，用兩次 _mm_mul_epu32 拼起來 (低 32 bit 和有號無關)
+static inline hv4 hv_muls(hv4 a, int32_t s)
+{
+    __m128i b = _mm_set1_epi32(s);
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+static inline hv4 hv_shr15(hv4 a) { return _mm_srai_epi32(a, 15); }
+static inline hv4 hv_lt(hv4 a, hv4 b) { return _mm_cmplt_epi32(a, b); }
+static inline hv4 hv_ge(hv4 a, hv4 b) { return _mm_xor_si128(_mm_cmplt_epi32(a, b), _mm_set1_epi32(-1)); }
+static inline hv4 hv_and(hv4 a, hv4 b) { return _mm_and_si128(a, b); }
+static inline hv4 hv_select(hv4 m, hv4 a, hv4 b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+static inline bool hv_any(hv4 m) { return _mm_movemask_epi8(m) != 0; }
+
+#else
+
+struct hv4 { int32_t v[4]; };
+static inline hv4 hv_load(const uint32_t *p, int step)
+{
+    hv4 r;
+    for (int i = 0; i < 4; ++i) r.v[i] = (int32_t)p[i * step];
+    return r;
+}
+static inline hv4 hv_set1(int32_t s) { hv4 r; for (int i = 0; i < 4; ++i) r.v[i] = s; return r; }
+static inline hv4 hv_loadi(const int32_t *p) { hv4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline void hv_store(int32_t *p, hv4 a) { std::memcpy(p, a.v, sizeof(a.v)); }
+static inline hv4 hv_add(hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] = (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i]); return a; }
+static inline hv4 hv_sub(hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] = (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i]); return a; }
+static inline hv4 hv_muls(hv4 a, int32_t s) { for (int i = 0; i < 4; ++i) a.v[i] = (int32_t)((uint32_t)a.v[i] * (uint32_t)s); return a; }
+static inline hv4 hv_shr15(hv4 a) { for (int i = 0; i < 4; ++i) a.v[i] >>= 15; return a; }
+static inline hv4 hv_lt(hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] < b.v[i] ? -1 : 0; return a; }
+static inline hv4 hv_ge(hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] >= b.v[i] ? -1 : 0; return a; }
+static inline hv4 hv_and(hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] &= b.v[i]; return a; }
+static inline hv4 hv_select(hv4 m, hv4 a, hv4 b) { for (int i = 0; i < 4; ++i) a.v[i] = m.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline bool hv_any(hv4 m) { return (m.v[0] | m.v[1] | m.v[2] | m.v[3]) != 0; }
+
+#endif
+
+// ---- integral image ----------------------------------------------------------
+
+// sum / sq 都是 (h+1) 列、每列 stride 個 uint32，第 0 列和第 0 行是 0
+static inline void haar_integral(const uint8_t *src, int src_step, int w, int h,
+                                 uint32_t *sum, uint32_t *sq, int stride)
+{
+    std::memset(sum, 0, sizeof(uint32_t) * (w + 1));
+    std::memset(sq, 0, sizeof(uint32_t) * (w + 1));
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *row = src + (size_t)y * src_step;
+        const uint32_t *prev_s = sum + (size_t)y * stride + 1;
+        const uint32_t *prev_q = sq + (size_t)y * stride + 1;
+        uint32_t *out_s = sum + (size_t)(y + 1) * stride;
+        uint32_t *out_q = sq + (size_t)(y + 1) * stride;
+        out_s[0] = 0;
+        out_q[0] = 0;
+        out_s++;
+        out_q++;
+
+        uint32_t carry_s = 0, carry_q = 0;
+        int x = 0;
+#if defined(HAAR_USE_NEON)
+        uint32x4_t zero = vdupq_n_u32(0);
+        uint32x4_t cs = zero, cq = zero;
+        for (; x + 8 <= w; x += 8) {
+            uint16x8_t p16 = vmovl_u8(vld1_u8(row + x));
+            uint16x8_t q16 = vmulq_u16(p16, p16);    // 255^2 還放得進 uint16
+            uint32x4_t halves_s[2] = { vmovl_u16(vget_low_u16(p16)), vmovl_u16(vget_high_u16(p16)) };
+            uint32x4_t halves_q[2] = { vmovl_u16(vget_low_u16(q16)), vmovl_u16(vget_high_u16(q16)) };
+            for (int k = 0; k < 2; ++k) {
+                uint32x4_t s = halves_s[k], q = halves_q[k];
+                // 向量內的 prefix sum：往高位 shift 1 個、2 個 lane 再相加
+                s = vaddq_u32(s, vextq_u32(zero, s, 3));
+                s = vaddq_u32(s, vextq_u32(zero, s, 2));
+                q = vaddq_u32(q, vextq_u32(zero, q, 3));
+                q = vaddq_u32(q, vextq_u32(zero, q, 2));
+                s = vaddq_u32(s, cs);
+                q = vaddq_u32(q, cq);
+                cs = vdupq_n_u32(vgetq_lane_u32(s, 3));
+                cq = vdupq_n_u32(vgetq_lane_u32(q, 3));
+                vst1q_u32(out_s + x + 4 * k, vaddq_u32(s, vld1q_u32(prev_s + x + 4 * k)));
+                vst1q_u32(out_q + x + 4 * k, vaddq_u32(q, vld1q_u32(prev_q + x + 4 * k)));
+            }
+        }
+        carry_s = vgetq_lane_u32(cs, 0);
+        carry_q = vgetq_lane_u32(cq, 0);
+#elif defined(HAAR_USE_SSE2)
+        __m128i zero = _mm_setzero_si128();
+        __m128i cs = zero, cq = zero;
+        for (; x + 8 <= w; x += 8) {
+            __m128i p16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x)), zero);
+            __m128i q16 = _mm_mullo_epi16(p16, p16);    // 255^2 還放得進 uint16
+            __m128i halves_s[2] = { _mm_unpacklo_epi16(p16, zero), _mm_unpackhi_epi16(p16, zero) };
+            __m128i halves_q[2] = { _mm_unpacklo_epi16(q16, zero), _mm_unpackhi_epi16(q16, zero) };
+            for (int k = 0; k < 2; ++k) {
+                __m128i s = halves_s[k], q = halves_q[k];
+                // 向量內的 prefix sum：往高位 shift 1 個、2 個 lane 再相加
+                s = _mm_add_epi32(s, _mm_slli_si128(s, 4));
+                s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+                q = _mm_add_epi32(q, _mm_slli_si128(q, 4));
+                q = _mm_add_epi32(q, _mm_slli_si128(q, 8));
+                s = _mm_add_epi32(s, cs);
+                q = _mm_add_epi32(q, cq);
+                cs = _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 3, 3, 3));
+                cq = _mm_shuffle_epi32(q, _MM_SHUFFLE(3, 3, 3, 3));
+                _mm_storeu_si128((__m128i*)(out_s + x + 4 * k),
+                                 _mm_add_epi32(s, _mm_loadu_si128((const __m128i*)(prev_s + x + 4 * k))));
+                _mm_storeu_si128((__m128i*)(out_q + x + 4 * k),
+                                 _mm_add_epi32(q, _mm_loadu_si128((const __m128i*)(prev_q + x + 4 * k))));
+            }
+        }
+        carry_s = (uint32_t)_mm_cvtsi128_si32(cs);
+        carry_q = (uint32_t)_mm_cvtsi128_si32(cq);
+#endif
+        for (; x < w; ++x) {
+            uint32_t p = row[x];
+            carry_s += p;
+            carry_q += p * p;
+            out_s[x] = carry_s + prev_s[x];
+            out_q[x] = carry_q + prev_q[x];
+        }
+    }
+}
+
+// ---- cascade -----------------------------------------------------------------
+
+struct haar_rect_q
+{
+    int x, y, w, h;
+    int32_t weight;
+};
+
+struct haar_feature_q
+{
+    int nrects;
+    haar_rect_q rect[3];
+};
+
+struct haar_stump_q
+{
+    int feature;
+    int32_t thr_q15;        // feature threshold * 2^15
+    int32_t left_q16;       // leaf * 2^16
+    int32_t right_q16;
+};
+
+struct haar_stage_q
+{
+    int first;
+    int count;
+    int32_t thr_q16;
+};
+
+struct haar_hit
+{
+    int x, y;
+};
+
+class haar_fixed_cascade
+{
+public:
+    haar_fixed_cascade() : win_w(0), win_h(0) {}
+
+    bool empty() const { return stages.empty(); }
+    cv::Size window_size() const { return cv::Size(win_w, win_h); }
+
+    bool load(const std::string &path)
+    {
+        stages.clear();
+        stumps.clear();
+        features.clear();
+        ofs_stride = -1;
+
+        cv::FileStorage fs(path, cv::FileStorage::READ);
+        if (!fs.isOpened()) return false;
+        cv::FileNode root = fs.getFirstTopLevelNode();
+        if (root.empty() || (std::string)root["featureType"] != "HAAR") {
+            std::cerr << "Error: " << path << " is not a new-format HAAR cascade." << std::endl;
+            return false;
+        }
+        win_w = (int)root["width"];
+        win_h = (int)root["height"];
+        // scan 裡 nf * thr_q15 是 int32：nf 最大是 127.5 * (w-2)(h-2) (一半 0 一半 255)，
+        // 24x24 是 61710，乘上 2^15 約 2.02e9 剛好放得下，再大的 window 會 overflow
+        if (win_w < 3 || win_h < 3 || 127.5 * (win_w - 2) * (win_h - 2) * 32768.0 > (double)INT32_MAX) {
+            std::cerr << "Error: " << win_w << "x" << win_h << " window in " << path
+                      << " is too large for the fixed-point detector." << std::endl;
+            return false;
+        }
+
+        cv::FileNode fstages = root["stages"];
+        for (size_t si = 0; si < fstages.size(); ++si) {
+            cv::FileNode st = fstages[(int)si];
+            haar_stage_q stage;
+            stage.first = (int)stumps.size();
+            // OpenCV 讀進來時會減掉 THRESHOLD_EPS
+            stage.thr_q16 = (int32_t)std::floor(((double)(float)st["stageThreshold"] - 1e-5) * 65536.0 + 0.5);
+            cv::FileNode weak = st["weakClassifiers"];
+            for (size_t wi = 0; wi < weak.size(); ++wi) {
+                cv::FileNode nodes = weak[(int)wi]["internalNodes"];
+                cv::FileNode leaves = weak[(int)wi]["leafValues"];
+                if (nodes.size() != 4 || leaves.size() != 2) {
+                    std::cerr << "Error: " << path << " uses trees deeper than a stump, not supported." << std::endl;
+                    stages.clear();
+                    return false;
+                }
+                double thr = (float)nodes[3];
+                if (std::fabs(thr) >= 1.0) {
+                    std::cerr << "Error: feature threshold out of fixed-point range in " << path << std::endl;
+                    stages.clear();
+                    return false;
+                }
+                haar_stump_q s;
+                s.feature = (int)nodes[2];
+                s.thr_q15 = (int32_t)std::floor(thr * 32768.0 + 0.5);
+                s.left_q16 = (int32_t)std::floor((double)(float)leaves[0] * 65536.0 + 0.5);
+                s.right_q16 = (int32_t)std::floor((double)(float)leaves[1] * 65536.0 + 0.5);
+                stumps.push_back(s);
+            }
+            stage.count = (int)stumps.size() - stage.first;
+            stages.push_back(stage);
+        }
+
+        cv::FileNode ffeatures = root["features"];
+        for (size_t fi = 0; fi < ffeatures.size(); ++fi) {
+            cv::FileNode f = ffeatures[(int)fi];
+            if (!f["tilted"].empty() && (int)f["tilted"] != 0) {
+                std::cerr << "Error: tilted Haar features are not supported." << std::endl;
+                stages.clear();
+                return false;
+            }
+            cv::FileNode rects = f["rects"];
+            haar_feature_q feat;
+            feat.nrects = 0;
+            for (size_t ri = 0; ri < rects.size() && ri < 3; ++ri) {
+                cv::FileNode r = rects[(int)ri];
+                float weight = (float)r[4];
+                // stock 的 Haar cascade 權重都是 -1 / 2 / 3 這種整數
+                if (weight != std::floor(weight)) {
+                    std::cerr << "Error: non-integer rect weight in " << path << ", not supported." << std::endl;
+                    stages.clear();
+                    return false;
+                }
+                haar_rect_q &q = feat.rect[feat.nrects++];
+                q.x = (int)r[0];
+                q.y = (int)r[1];
+                q.w = (int)r[2];
+                q.h = (int)r[3];
+                q.weight = (int32_t)weight;
+            }
+            features.push_back(feat);
+        }
+        for (const auto &s : stumps) {
+            if (s.feature < 0 || s.feature >= (int)features.size()) {
+                std::cerr << "Error: bad feature index in " << path << std::endl;
+                stages.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 掃過一個 scale 的所有 window，通過全部 stage 的左上角放進 hits
+    // x 在 [0, x_end)、y 在 [0, y_end)，間距都是 step
+    void scan(const uint32_t *sum, const uint32_t *sq, int stride, int x_end, int y_end, int step,
+              std::vector<haar_hit> &hits) const
+    {
+        prepare_offsets(stride);
+        const int norm_area = (win_w - 2) * (win_h - 2);
+        const double min_nf = 10.0 * norm_area;     // OpenCV: area * varianceNormFactor < 0.1
+        const int *nofs = norm_ofs;
+
+        int32_t nf_lane[4];
+        int32_t alive_lane[4];
+        for (int y = 0; y < y_end; y += step) {
+            const uint32_t *srow = sum + (size_t)y * stride;
+            const uint32_t *qrow = sq + (size_t)y * stride;
+            for (int x = 0; x < x_end; x += 4 * step) {
+                // 每個 window 的標準差 (scalar，每個 lane 一次 sqrt)
+                bool any_alive = false;
+                for (int l = 0; l < 4; ++l) {
+                    int wx = x + l * step;
+                    nf_lane[l] = 0;
+                    alive_lane[l] = 0;
+                    if (wx >= x_end) continue;
+                    const uint32_t *s = srow + wx;
+                    const uint32_t *q = qrow + wx;
+                    int32_t valsum = (int32_t)(s[nofs[0]] - s[nofs[1]] - s[nofs[2]] + s[nofs[3]]);
+                    uint32_t valsq = q[nofs[0]] - q[nofs[1]] - q[nofs[2]] + q[nofs[3]];
+                    double nf = (double)norm_area * valsq - (double)valsum * valsum;
+                    if (nf <= 0.0) continue;
+                    nf = std::sqrt(nf);
+                    if (nf <= min_nf) continue;
+                    nf_lane[l] = (int32_t)(nf + 0.5);
+                    alive_lane[l] = -1;
+                    any_alive = true;
+                }
+                if (!any_alive) continue;
+
+                hv4 nf = hv_loadi(nf_lane);
+                hv4 alive = hv_loadi(alive_lane);
+                const uint32_t *base = srow + x;
+                for (size_t si = 0; si < stages.size(); ++si) {
+                    const haar_stage_q &stage = stages[si];
+                    hv4 acc = hv_set1(0);
+                    for (int k = 0; k < stage.count; ++k) {
+                        const haar_stump_q &s = stumps[stage.first + k];
+                        const int *o = &rect_ofs[(size_t)s.feature * 12];
+                        const int32_t *wts = &rect_wts[(size_t)s.feature * 3];
+                        hv4 f = hv_muls(rect_sum(base, o, step), wts[0]);
+                        f = hv_add(f, hv_muls(rect_sum(base, o + 4, step), wts[1]));
+                        if (wts[2] != 0) {
+                            f = hv_add(f, hv_muls(rect_sum(base, o + 8, step), wts[2]));
+                        }
+                        hv4 thr = hv_shr15(hv_muls(nf, s.thr_q15));
+                        acc = hv_add(acc, hv_select(hv_lt(f, thr), hv_set1(s.left_q16), hv_set1(s.right_q16)));
+                    }
+                    alive = hv_and(alive, hv_ge(acc, hv_set1(stage.thr_q16)));
+                    if (!hv_any(alive)) break;
+                }
+
+                if (hv_any(alive)) {
+                    hv_store(alive_lane, alive);
+                    for (int l = 0; l < 4; ++l) {
+                        if (alive_lane[l]) {
+                            haar_hit h;
+                            h.x = x + l * step;
+                            h.y = y;
+                            hits.push_back(h);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 參數意義和 cv::CascadeClassifier::detectMultiScale 相同 (flags 固定為 0)
+    void detect(const cv::Mat &gray, std::vector<cv::Rect> &objects, double scale_factor,
+                int min_neighbors, cv::Size min_size, cv::Size max_size)
+    {
+        objects.clear();
+        if (empty() || gray.empty()) return;
+        if (max_size.width == 0 || max_size.height == 0) max_size = gray.size();
+
+        std::vector<haar_hit> hits;
+        for (double factor = 1.0; ; factor *= scale_factor) {
+            cv::Size win(cvRound(win_w * factor), cvRound(win_h * factor));
+            cv::Size scaled(cvRound(gray.cols / factor), cvRound(gray.rows / factor));
+            int x_end = scaled.width - win_w;
+            int y_end = scaled.height - win_h;
+            if (x_end <= 0 || y_end <= 0) break;
+            if (win.width > max_size.width || win.height > max_size.height) break;
+            if (win.width < min_size.width || win.height < min_size.height) continue;
+
+            const cv::Mat *img = &gray;
+            if (scaled != gray.size()) {
+                cv::resize(gray, scaled_buf, scaled, 0, 0, cv::INTER_LINEAR);
+                img = &scaled_buf;
+            }
+
+            // 多留 16 個元素，最後一列的 4 lane (step 2) 讀取才不會越界
+            int stride = scaled.width + 1;
+            size_t need = (size_t)(scaled.height + 1) * stride + 16;
+            if (sum_buf.size() < need) {
+                sum_buf.resize(need);
+                sq_buf.resize(need);
+            }
+            haar_integral(img->ptr<uint8_t>(0), (int)img->step, scaled.width, scaled.height,
+                          &sum_buf[0], &sq_buf[0], stride);
+
+            int step = factor > 2.0 ? 1 : 2;
+            hits.clear();
+            scan(&sum_buf[0], &sq_buf[0], stride, x_end, y_end, step, hits);
+            for (const auto &h : hits) {
+                objects.push_back(cv::Rect(cvRound(h.x * factor), cvRound(h.y * factor), win.width, win.height));
+            }
+        }
+        cv::groupRectangles(objects, min_neighbors, 0.2);
+    }
+
+private:
+    static inline hv4 rect_sum(const uint32_t *base, const int *o, int step)
+    {
+        return hv_add(hv_sub(hv_sub(hv_load(base + o[0], step), hv_load(base + o[1], step)),
+                             hv_load(base + o[2], step)),
+                      hv_load(base + o[3], step));
+    }
+
+    // 每個 rect 四個角在 integral image 裡相對 window 左上角的位移，stride 變了才重算
+    void prepare_offsets(int stride) const
+    {
+        if (stride == ofs_stride) return;
+        ofs_stride = stride;
+        rect_ofs.assign(features.size() * 12, 0);
+        rect_wts.assign(features.size() * 3, 0);
+        for (size_t fi = 0; fi < features.size(); ++fi) {
+            for (int r = 0; r < features[fi].nrects; ++r) {
+                const haar_rect_q &q = features[fi].rect[r];
+                int *o = &rect_ofs[fi * 12 + r * 4];
+                o[0] = q.y * stride + q.x;
+                o[1] = q.y * stride + q.x + q.w;
+                o[2] = (q.y + q.h) * stride + q.x;
+                o[3] = (q.y + q.h) * stride + q.x + q.w;
+                rect_wts[fi * 3 + r] = q.weight;
+            }
+        }
+        // normalization 用的是 window 內縮 1 pixel 的區域
+        norm_ofs[0] = 1 * stride + 1;
+        norm_ofs[1] = 1 * stride + (win_w - 1);
+        norm_ofs[2] = (win_h - 1) * stride + 1;
+        norm_ofs[3] = (win_h - 1) * stride + (win_w - 1);
+    }
+
+    int win_w, win_h;
+    std::vector<haar_stage_q> stages;
+    std::vector<haar_stump_q> stumps;
+    std::vector<haar_feature_q> features;
+
+    mutable int ofs_stride = -1;
+    mutable std::vector<int> rect_ofs;
+    mutable std::vector<int32_t> rect_wts;
+    mutable int norm_ofs[4];
+
+    cv::Mat scaled_buf;
+    std::vector<uint32_t> sum_buf;
+    std::vector<uint32_t> sq_buf;
+};
+
+#endif // HAAR_FIXED_H
@@ -22,11 +22,14 @@ void sigint_handler(int)
 int main ( int argc, const char *argv[] )
 {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <model_path>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <model_path> [cascade_path]" << std::endl;
         return 1;
     }
     std::string model_path = argv[1];
     std::string face_cascade_path = "./haarcascades/haarcascade_frontalface_default.xml";
+    if (argc >= 3) {
+        face_cascade_path = argv[2];    // Haar 或 LBP cascade 都可以
+    }
     
     std::signal(SIGINT, sigint_handler);
 
@@ -42,10 +45,10 @@ int main ( int argc, const char *argv[] )
     camera.set(cv::CAP_PROP_FRAME_HEIGHT, 720);
     camera.set(cv::CAP_PROP_FPS, 30);
 
-    // 載入 Haar Cascade 模型
+    // 載入 Cascade 模型
     cv::CascadeClassifier face_cascade;
     if (!face_cascade.load(face_cascade_path)) {
-        std::cerr << "Error: Cannot load Haar cascade classifier." << std::endl;
+        std::cerr << "Error: Cannot load cascade classifier " << face_cascade_path << std::endl;
         return 1;
     }
 
@@ -5,27 +5,25 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <csignal>
+#include <cstdio>
 #include <cstring>
 #include <cstdint>
+#include <sstream>
 #include <string>
+#include <chrono>
+#include <vector>
 
 #include <linux/fb.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/face.hpp>
 
-struct framebuffer_info
-{
-    uint32_t bits_per_pixel;    // depth of framebuffer
-    uint32_t xres_virtual;      // 記憶體中每一列實際保留的pixel數，包含為panning或其他所保留的空間
-    uint32_t yres_virtual;      // (visible resolution就沒有包含這些，所以通常較小)
-    uint32_t xres;
-    uint32_t yres;
-    uint32_t line_length;       // bytes per row in framebuffer (包含 padding)
-    size_t smem_len;            // total framebuffer memory len
-};
+#include "face_pipeline.h"
+#include "fb_output.h"
+#include "latency_probe.h"
 
 struct framebuffer_info get_framebuffer_info (int fd_fb);
 
@@ -58,7 +56,6 @@ void sigint_handler(int)
     cleanup_and_exit(0);
 }
 
-std::string face_cascade_path = "./haarcascades/haarcascade_frontalface_default.xml";
 std::string model_path = "./lbph_model_all.yml";
 
 // 這顆鏡頭解析度最高 1280x960(7.5fps)
@@ -67,175 +64,443 @@ int cam_width = 640;
 int cam_height = 480;
 float cam_fps = 10;
 
+int stats_interval = 100;   // 每幾個 frame 印一次統計
+
+// headless 模式：每個 frame 輸出一行 JSON (時間戳、框、label、信心值、各 stage 時間)
+void write_json_line(std::ostream &os, uint64_t frame_idx, double ts_ms,
+                     const std::vector<face_result> &faces, const stage_stats &stats)
+{
+    char buf[192];
+    std::snprintf(buf, sizeof(buf), "{\"frame\":%llu,\"ts_ms\":%.3f,\"faces\":[",
+                  (unsigned long long)frame_idx, ts_ms);
+    os << buf;
+    for (size_t i = 0; i < faces.size(); ++i) {
+        const face_result &f = faces[i];
+        std::string name = (f.label >= 0 && label_names.count(f.label)) ? label_names[f.label] : "";
+        std::snprintf(buf, sizeof(buf), "%s{\"id\":%d,\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d,\"label\":%d,\"name\":\"%s\",\"confidence\":%.3f}",
+                      i ? "," : "", f.id, f.box.x, f.box.y, f.box.width, f.box.height, f.label, name.c_str(), f.confidence);
+        os << buf;
+    }
+    // 這張 frame 沒跑的 stage (motion gate 沒開、tracker 模式跳過偵測…) 不輸出
+    os << "],\"timings_ms\":{";
+    const int timed[] = { STAGE_CAPTURE, STAGE_GRAY, STAGE_RESIZE, STAGE_MOTION, STAGE_DETECT, STAGE_TRACK, STAGE_RECOGNIZE };
+    bool first = true;
+    for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); ++i) {
+        if (!stats.ran(timed[i])) continue;
+        std::snprintf(buf, sizeof(buf), "%s\"%s\":%.3f", first ? "" : ",",
+                      stats.stage_names()[timed[i]].c_str(), stats.frame_ms(timed[i]));
+        os << buf;
+        first = false;
+    }
+    os << "}}\n";
+}
+
+// 模型檔裡有名字、label_names 沒有的 label (線上註冊的人) 補進 label_names
+void merge_model_names(const face_pipeline &pipeline)
+{
+    for (const auto &n : pipeline.binary_model().names()) {
+        if (!label_names.count(n.first)) label_names[n.first] = n.second;
+    }
+}
+
+// 名字已經有 label 就沿用 (同一個人多收幾張)，否則給一個新的
+int enroll_label_for(const std::string &name, const face_pipeline &pipeline)
+{
+    int next = pipeline.binary_model().next_label();
+    for (const auto &n : label_names) {
+        if (n.second == name) return n.first;
+        next = std::max(next, n.first + 1);
+    }
+    return next;
+}
+
+// stdin 讀一行指令，沒有完整的一行就馬上回傳 false (不卡住主迴圈)
+std::string stdin_pending;
+bool stdin_closed = false;
+
+bool poll_command(std::string &line)
+{
+    while (!stdin_closed) {
+        size_t nl = stdin_pending.find('\n');
+        if (nl != std::string::npos) {
+            line = stdin_pending.substr(0, nl);
+            stdin_pending.erase(0, nl + 1);
+            return true;
+        }
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) <= 0) return false;
+        char buf[256];
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n <= 0) {
+            stdin_closed = true;    // 背景執行或 < /dev/null
+            return false;
+        }
+        stdin_pending.append(buf, n);
+    }
+    return false;
+}
+
+// 執行中可以從 stdin 下的指令：
+//   enroll <name> [N]   線上註冊畫面中最大的那張臉 (收 N 張)
+//   cancel              取消註冊
+//   save                註冊的樣本合併寫回模型檔
+void handle_command(const std::string &line, face_pipeline &pipeline, const std::string &model_path)
+{
+    std::istringstream in(line);
+    std::string cmd, name;
+    int samples = 0;
+    in >> cmd;
+    if (cmd == "enroll" && (in >> name)) {
+        in >> samples;
+        int label = enroll_label_for(name, pipeline);
+        if (pipeline.start_enroll(label, name, samples)) {
+            std::cerr << "Enrolling " << name << " as label " << label << ", look at the camera" << std::endl;
+        }
+    } else if (cmd == "cancel") {
+        pipeline.cancel_enroll();
+    } else if (cmd == "save") {
+        if (pipeline.save_model(model_path)) std::cerr << "Saved " << model_path << std::endl;
+    } else if (!cmd.empty()) {
+        std::cerr << "Unknown command: " << line << " (enroll <name> [N] | cancel | save)" << std::endl;
+    }
+}
+
+// 螢幕顯示序號 pattern、鏡頭拍回來解碼，量 glass-to-glass 延遲
+// loopback 為 true 時 framebuffer 和 camera 都換成記憶體 (virtual_loopback)
+void run_latency_test(cv::VideoCapture &camera, virtual_loopback *loopback,
+                      const framebuffer_info &fb_info, uint8_t *fb_ptr,
+                      face_pipeline &pipeline, stage_stats &stats, int samples, cv::Rect roi)
+{
+    typedef std::chrono::steady_clock clock;
+    latency_recorder recorder;
+    std::vector<face_result> faces;
+    cv::Size pattern_size = loopback ? cv::Size(cam_width, cam_height) : cv::Size(fb_info.xres, fb_info.yres);
+    cv::Mat pattern(pattern_size, CV_8UC3);
+    cv::Mat frame;
+    uint32_t seq = 0;
+    int max_iterations = samples * 20;  // 一直解不出來就放棄
+
+    for (int iter = 0; iter < max_iterations && (int)recorder.sample_count() < samples; ++iter) {
+        if (loopback) {
+            loopback->read(frame);
+        } else {
+            camera >> frame;
+        }
+        clock::time_point captured = clock::now();
+        if (frame.empty()) {
+            std::cerr << "Error:No Image , capture failed" << std::endl;
+            break;
+        }
+        // 鏡頭拍到的螢幕通常只佔畫面的一部分，--g2g-roi 指定 pattern 在 camera 畫面裡的位置
+        cv::Rect area = roi.area() > 0 ? roi & cv::Rect(0, 0, frame.cols, frame.rows) : cv::Rect(0, 0, frame.cols, frame.rows);
+        int seen = area.area() > 0 ? decode_latency_pattern(frame, area) : -1;
+
+        // 一樣跑完整的偵測 + 辨識，延遲才包含處理時間
+        pipeline.process(frame, faces);
+
+        seq++;
+        draw_latency_pattern(pattern, seq);
+        if (loopback) {
+            loopback->present(pattern);
+        } else {
+            write_to_fb(pattern, fb_info, fb_ptr, stats);
+        }
+        clock::time_point presented = clock::now();
+        recorder.presented(seq, presented);
+        recorder.observed(seen, captured, presented);
+        stats.end_frame();
+    }
+    recorder.report(std::cout);
+}
+
 int main ( int argc, const char *argv[] )
 {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <model_path>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <model_path> [width height fps] [--stats] [--perf]"
+                  << " [--cascade <xml>] [--min-neighbors N] [--native-detector] [--motion-gate] [--full-scan-interval N]"
+                  << " [--track] [--detect-interval N] [--smooth] [--recognize-interval N] [--recognize-threads N] [--pyramid-crops] [--roi-redetect] [--roi-full-interval K] [--detect-threads N] [--headless] [--json <file>] [--input <video>]"
+                  << " [--g2g | --g2g-loopback] [--g2g-samples N] [--g2g-roi x,y,w,h] [--loopback-delay ms]"
+                  << " [--enroll <name>] [--enroll-samples N] [--no-hot-reload]"
+                  << " [--unknown-threshold D] [--class-threshold label=D,...] [--top-k N]" << std::endl;
         return 1;
     }
     std::string model_path = argv[1];
 
-    if (argc >= 5) {
-        cam_width = atoi(argv[2]);
-        cam_height = atoi(argv[3]);
-        cam_fps = atoi(argv[4]);
+    stage_stats stats(pipeline_stage_names());
+    pipeline_config cfg;
+    bool print_stats = false;
+    bool want_perf = false;
+    bool headless = false;
+    std::string json_path;      // 空字串代表 stdout
+    std::string input_path;     // 空字串代表 camera
+    bool g2g = false;
+    bool g2g_loopback = false;
+    int g2g_samples = 300;
+    cv::Rect g2g_roi;           // 空的 = 整個 camera 畫面
+    double loopback_delay_ms = 0.0;
+    std::string enroll_name;    // 開始就註冊這個人 (執行中也可以從 stdin 下 enroll 指令)
+    bool hot_reload = true;     // 模型或 cascade 檔更新時自動換上，不用重開
+    std::vector<const char*> positional;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            print_stats = true;
+        } else if (arg == "--perf") {
+            print_stats = true;
+            want_perf = true;
+        } else if (arg == "--cascade" && i + 1 < argc) {
+            cfg.cascade_path = argv[++i];
+        } else if (arg == "--min-neighbors" && i + 1 < argc) {
+            cfg.min_neighbors = atoi(argv[++i]);
+        } else if (arg == "--native-detector") {
+            cfg.native_detector = true;
+        } else if (arg == "--motion-gate") {
+            cfg.motion_gate = true;
+        } else if (arg == "--full-scan-interval" && i + 1 < argc) {
+            cfg.motion.full_scan_interval = atoi(argv[++i]);
+        } else if (arg == "--track") {
+            cfg.tracker = true;
+        } else if (arg == "--detect-interval" && i + 1 < argc) {
+            cfg.tracker = true;
+            cfg.track.detect_interval = atoi(argv[++i]);
+        } else if (arg == "--recognize-interval" && i + 1 < argc) {
+            cfg.recog.interval = atoi(argv[++i]);
+        } else if (arg == "--recognize-threads" && i + 1 < argc) {
+            cfg.recognize_threads = atoi(argv[++i]);
+        } else if (arg == "--pyramid-crops") {
+            cfg.pyramid_crops = true;
+        } else if (arg == "--smooth") {
+            cfg.assoc.smooth = true;
+        } else if (arg == "--roi-redetect") {
+            cfg.roi_redetect = true;
+        } else if (arg == "--roi-full-interval" && i + 1 < argc) {
+            cfg.roi_redetect = true;
+            cfg.roi_full_interval = atoi(argv[++i]);
+        } else if (arg == "--detect-threads" && i + 1 < argc) {
+            cfg.detect_threads = atoi(argv[++i]);
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--json" && i + 1 < argc) {
+            headless = true;
+            json_path = argv[++i];
+        } else if (arg == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (arg == "--g2g") {
+            g2g = true;
+        } else if (arg == "--g2g-loopback") {
+            g2g = true;
+            g2g_loopback = true;
+        } else if (arg == "--g2g-samples" && i + 1 < argc) {
+            g2g_samples = atoi(argv[++i]);
+        } else if (arg == "--g2g-roi" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%d,%d,%d,%d", &g2g_roi.x, &g2g_roi.y, &g2g_roi.width, &g2g_roi.height) != 4 ||
+                g2g_roi.x < 0 || g2g_roi.y < 0 || g2g_roi.width <= 0 || g2g_roi.height <= 0) {
+                std::cerr << "Error: Bad --g2g-roi value: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--loopback-delay" && i + 1 < argc) {
+            loopback_delay_ms = atof(argv[++i]);
+        } else if (arg == "--enroll" && i + 1 < argc) {
+            enroll_name = argv[++i];
+        } else if (arg == "--enroll-samples" && i + 1 < argc) {
+            cfg.enroll.samples = atoi(argv[++i]);
+        } else if (arg == "--no-hot-reload") {
+            hot_reload = false;
+        } else if (arg == "--unknown-threshold" && i + 1 < argc) {
+            if (!lbph_parse_double(argv[++i], cfg.open_set.threshold)) {
+                std::cerr << "Error: Bad --unknown-threshold value: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--class-threshold" && i + 1 < argc) {
+            if (!cfg.open_set.parse_class_thresholds(argv[++i])) {
+                std::cerr << "Error: Bad --class-threshold value: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--top-k" && i + 1 < argc) {
+            if (!lbph_parse_int(argv[++i], cfg.top_k) || cfg.top_k < 1 || cfg.top_k > lbph_topk::max_k) {
+                std::cerr << "Error: Bad --top-k value: " << argv[i] << " (1 to " << (int)lbph_topk::max_k << ")" << std::endl;
+                return 1;
+            }
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
     }
-    
-    std::signal(SIGINT, sigint_handler);
 
-    int fd_fb = open("/dev/fb0", O_RDWR);
-    if (fd_fb < 0) {
-        std::cerr << "Error: Could not open framebuffer device /dev/fb0" << std::endl;
-        exit(1);
+    // 真的 glass-to-glass 要把 pattern 畫到螢幕上，headless 不開 /dev/fb0
+    if (g2g && !g2g_loopback && headless) {
+        std::cerr << "Error: --g2g needs the framebuffer, it cannot be combined with --headless/--json (use --g2g-loopback)" << std::endl;
+        return 1;
     }
-    fd_fb_global = fd_fb;
 
-    framebuffer_info fb_info = get_framebuffer_info(fd_fb);
-    size_t fb_size = fb_info.smem_len;
-    if (fb_size == 0) {
-        fb_size = (size_t)fb_info.yres_virtual * fb_info.line_length;
+    // 有個別門檻時第一名被自己的門檻擋掉還可以是第二名 (參數都讀完才調，--top-k 1 寫在後面也一樣)
+    if (!cfg.open_set.class_thresholds.empty()) cfg.top_k = std::max(cfg.top_k, 2);
+
+    if (positional.size() >= 3) {
+        cam_width = atoi(positional[0]);
+        cam_height = atoi(positional[1]);
+        cam_fps = atoi(positional[2]);
     }
-    fb_size_global = fb_size;
+    
+    std::signal(SIGINT, sigint_handler);
 
-    uint8_t *fb_ptr = (uint8_t*)mmap(nullptr, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_fb, 0);
-    if (fb_ptr == MAP_FAILED){
-        std::cerr << "Error: mmap failed"<< std::endl;
-        close(fd_fb);
-        exit(1);
+    // headless 和 loopback 不需要 /dev/fb0，在 PC 上也能跑
+    uint8_t *fb_ptr = nullptr;
+    framebuffer_info fb_info;
+    std::memset(&fb_info, 0, sizeof(fb_info));
+    if (!headless && !g2g_loopback) {
+        int fd_fb = open("/dev/fb0", O_RDWR);
+        if (fd_fb < 0) {
+            std::cerr << "Error: Could not open framebuffer device /dev/fb0" << std::endl;
+            exit(1);
+        }
+        fd_fb_global = fd_fb;
+
+        fb_info = get_framebuffer_info(fd_fb);
+        size_t fb_size = fb_info.smem_len;
+        if (fb_size == 0) {
+            fb_size = (size_t)fb_info.yres_virtual * fb_info.line_length;
+        }
+        fb_size_global = fb_size;
+
+        fb_ptr = (uint8_t*)mmap(nullptr, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_fb, 0);
+        if (fb_ptr == MAP_FAILED){
+            std::cerr << "Error: mmap failed"<< std::endl;
+            close(fd_fb);
+            exit(1);
+        }
+        fb_ptr_global = fb_ptr;
     }
-    fb_ptr_global = fb_ptr;
 
-    cv::VideoCapture camera(2);
-    if( !camera.isOpened() )
+    cv::VideoCapture camera;
+    if (g2g_loopback) {
+        // 不開 camera，由 virtual_loopback 代替
+    } else if (input_path.empty()) {
+        camera.open(2);
+    } else {
+        camera.open(input_path);
+    }
+    if( !g2g_loopback && !camera.isOpened() )
     {
         std::cerr << "Could not open video device." << std::endl;
         cleanup_and_exit(1);
     }
-    camera.set(cv::CAP_PROP_FRAME_WIDTH, cam_width);
-    camera.set(cv::CAP_PROP_FRAME_HEIGHT, cam_height);
-    camera.set(cv::CAP_PROP_FPS, cam_fps);
+    if (input_path.empty() && !g2g_loopback) {
+        camera.set(cv::CAP_PROP_FRAME_WIDTH, cam_width);
+        camera.set(cv::CAP_PROP_FRAME_HEIGHT, cam_height);
+        camera.set(cv::CAP_PROP_FPS, cam_fps);
+    }
 
     // 載入 Haar Cascade 模型
-    cv::CascadeClassifier face_cascade;
-    if (!face_cascade.load(face_cascade_path)) {
-        std::cerr << "Error: Cannot load Haar cascade classifier." << std::endl;
+    face_pipeline pipeline(cfg, stats);
+    if (!pipeline.load_cascade()) {
         cleanup_and_exit(1);
     }
 
     // === 載入 LBPH 模型 ===
-    cv::Ptr<cv::face::LBPHFaceRecognizer> recognizer = cv::face::LBPHFaceRecognizer::create();
-    try {
-        recognizer->read(model_path);
-    } catch (...) {
-        std::cerr << "Warning: Could not load LBPH model. Recognition will be skipped." << std::endl;
+    pipeline.load_model(model_path);
+    merge_model_names(pipeline);
+    if (hot_reload && !g2g) {
+        pipeline.enable_hot_reload();
+    }
+    if (!enroll_name.empty()) {
+        handle_command("enroll " + enroll_name, pipeline, model_path);
+    }
+
+    std::ofstream json_file;
+    std::ostream *json_out = &std::cout;
+    if (headless && !json_path.empty()) {
+        json_file.open(json_path.c_str());
+        if (!json_file) {
+            std::cerr << "Error: Could not open " << json_path << std::endl;
+            cleanup_and_exit(1);
+        }
+        json_out = &json_file;
+    }
+
+    // headless 需要每個 frame 的 stage 時間，所以統計一律打開
+    if (headless || print_stats) {
+        stats.enable();
+    }
+    if (want_perf) {
+        stats.enable_perf();
+    }
+
+    if (g2g) {
+        virtual_loopback loopback(cv::Size(cam_width, cam_height), loopback_delay_ms);
+        run_latency_test(camera, g2g_loopback ? &loopback : nullptr, fb_info, fb_ptr,
+                         pipeline, stats, g2g_samples, g2g_roi);
+        camera.release();
+        cleanup_and_exit(0);
     }
 
     // 目標 framebuffer 的顯示大小 (visible)
     const int fb_width = fb_info.xres;
     const int fb_height = fb_info.yres;
-    const int fb_line_len = fb_info.line_length;
-    const size_t max_row_bytes = (size_t)fb_line_len;
 
     cv::Mat frame;      // variable to store the frame get from video stream
+    std::vector<face_result> faces;
+    uint64_t frame_idx = 0;
 
     while ( true )
     {
+        stats.begin(STAGE_CAPTURE);
         camera >> frame;
+        stats.end(STAGE_CAPTURE);
          if (frame.empty()) {
-            std::cerr << "Error:No Image , capture failed" << std::endl;
+            if (input_path.empty()) {
+                std::cerr << "Error:No Image , capture failed" << std::endl;
+            }
             break;
         }
+        double ts_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
 
-        // 人臉偵測
-        cv::Mat gray;
-        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-        cv::equalizeHist(gray, gray);
-
-        cv::Mat small_gray;
-        const double small_scale = 2.0;
-        cv::resize(
-            gray, small_gray, 
-            cv::Size(), 1.0 / small_scale, 1.0 / small_scale
-        );
-
-        std::vector<cv::Rect> faces;
-        cv::Size minSize(gray.cols / 20, gray.rows / 20);
-        cv::Size maxSize(gray.cols / 2, gray.rows / 2);
-        face_cascade.detectMultiScale(
-            small_gray, faces,
-            1.1, 6, 0, minSize, maxSize
-        );
-
-        for (auto &face : faces) {
-            face.x = cvRound(face.x * small_scale);
-            face.y = cvRound(face.y * small_scale);
-            face.width = cvRound(face.width * small_scale);
-            face.height = cvRound(face.height * small_scale);
-            cv::rectangle(frame, face, cv::Scalar(0, 255, 0), 2);
-
-            // 進行辨識
-            cv::Mat faceROI = gray(face);
-            cv::resize(faceROI, faceROI, cv::Size(100, 100));
-            int label = -1;
-            double confidence = 0.0;
-            if (!recognizer.empty()) {
-                recognizer->predict(faceROI, label, confidence);
-            }
-
-            std::string text;
-            // if (label >= 0 && confidence < 90.0) { // 信心值越低越準確
-            //     text = label_names[label];
-            // } else {
-            //     text = "Unknown";
-            // }
+        std::string command;
+        while (poll_command(command)) {
+            handle_command(command, pipeline, model_path);
+        }
+        bool enrolling = pipeline.enrollment().active();
+        int model_version = pipeline.model_version();
+        pipeline.process(frame, faces);
+        // 註冊完或熱更新換了模型，新的名字補進 label_names
+        if ((enrolling && !pipeline.enrollment().active()) || model_version != pipeline.model_version()) {
+            merge_model_names(pipeline);
+        }
 
-            if (label >= 0) {
-                text = label_names[label];
+        if (headless) {
+            write_json_line(*json_out, frame_idx++, ts_ms, faces, stats);
+            stats.end_frame();
+            if (print_stats && stats.frame_count() >= (uint64_t)stats_interval) {
+                stats.report(std::cerr);
             }
-
-            cv::putText(frame, text + ", confidence: " + std::to_string(confidence), cv::Point(face.x, face.y - 10),
-                        cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
+            continue;
         }
 
-        double scale_x = (double)fb_width / (double)frame.cols;
-        double scale_y = (double)fb_height / (double)frame.rows;
-        double scale = std::min(scale_x, scale_y);
-        if (scale <= 0) scale = 1.0;
-        int new_w = std::max(1, (int)std::round(frame.cols * scale));
-        int new_h = std::max(1, (int)std::round(frame.rows * scale));
+        stats.begin(STAGE_COMPOSE);
+        draw_faces(frame, faces, pipeline.enrollment(), label_names, pipeline.has_model());
 
-        cv::Mat display_frame;
-        if (new_w != frame.cols || new_h != frame.rows) {
-            cv::resize(frame, display_frame, cv::Size(new_w, new_h), 0, 0, cv::INTER_AREA);
-        } else {
-            display_frame = frame;
-        }
+        cv::Mat background = letterbox_to_fb(frame, fb_width, fb_height,
+                                             &pipeline.pyramid(), &pipeline.buffers_pool());
+        stats.end(STAGE_COMPOSE);
 
-        cv::Mat background = cv::Mat::zeros(cv::Size(fb_width, fb_height), display_frame.type());
-        int x_offset = (fb_width - display_frame.cols) / 2;
-        int y_offset = (fb_height - display_frame.rows) / 2;
-        if (x_offset < 0) x_offset = 0;
-        if (y_offset < 0) y_offset = 0;
-        cv::Rect roi(x_offset, y_offset, display_frame.cols, display_frame.rows);
-        display_frame.copyTo(background(roi));
-
-        cv::Mat converted_image;
-        cv::cvtColor(background, converted_image, cv::COLOR_BGR2BGR565);
-        
-        size_t row_bytes = (size_t)fb_width * 2;
-        if (row_bytes > max_row_bytes) row_bytes = max_row_bytes; // safety
-
-        for (int y = 0; y < fb_height; ++y) {
-            uint8_t *dst_row = fb_ptr + (size_t)y * fb_line_len;
-            std::memset(dst_row, 0, fb_line_len);   // 清除整列 (包含 padding) 以避免殘留像素
-            const uint8_t *src_row = converted_image.ptr<uint8_t>(y);
-            std::memcpy(dst_row, src_row, row_bytes);
+        write_to_fb(background, fb_info, fb_ptr, stats);
+        pipeline.buffers_pool().release(background);
+
+        stats.end_frame();
+        if (print_stats && stats.frame_count() >= (uint64_t)stats_interval) {
+            stats.report(std::cerr);
         }
 
         usleep(1000);
     }
     
     camera.release();
+    if (json_file.is_open()) {
+        json_file.close();
+    }
     cleanup_and_exit(0);
 
     return 0;
@@ -0,0 +1,192 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+// Glass-to-glass 延遲量測
+// 在畫面上顯示 4x4 的黑白格子，前 8 格是序號、後 8 格是序號的反相 (用來檢查解碼是否正確)，
+// 讓鏡頭對著螢幕拍回來解碼，就知道這張 frame 看到的是哪一次 present。
+// 解碼只看 camera 畫面裡的一個矩形 (lab3-1 的 --g2g-roi)，螢幕要在那個矩形裡大致擺正、填滿；
+// 沒指定時用整個畫面，只有螢幕剛好佔滿鏡頭 (或 loopback) 才解得出來。
+//   g2g    = 這次 present 的時間 - 拍到的那個 pattern 的 present 時間
+//            (畫面改變 → 反應這個改變的結果被顯示出來，就是使用者看到的延遲)
+//   sw     = 這次 present 的時間 - 這張 frame 從 camera 拿到的時間 (純軟體部分)
+// loopback 版本把 framebuffer 換成記憶體裡的 cv::Mat、camera 換成讀這塊記憶體，
+// 在 PC 上就能單獨量軟體的延遲。
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "stage_stats.h"
+
+const int latency_grid = 4;     // 4x4 = 8 bits 序號 + 8 bits 反相
+
+inline void draw_latency_pattern(cv::Mat &bgr, uint32_t seq)
+{
+    uint32_t code = (seq & 0xFF) | ((~seq & 0xFF) << 8);
+    int cell_w = bgr.cols / latency_grid;
+    int cell_h = bgr.rows / latency_grid;
+    bgr.setTo(cv::Scalar(0, 0, 0));
+    for (int bit = 0; bit < latency_grid * latency_grid; ++bit) {
+        if (!(code & (1u << bit))) continue;
+        int gx = bit % latency_grid;
+        int gy = bit / latency_grid;
+        cv::rectangle(bgr, cv::Rect(gx * cell_w, gy * cell_h, cell_w, cell_h),
+                      cv::Scalar(255, 255, 255), cv::FILLED);
+    }
+}
+
+// 回傳解出來的序號 (0~255)，解不出來回傳 -1
+inline int decode_latency_pattern(const cv::Mat &frame, const cv::Rect &roi)
+{
+    cv::Mat gray;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame(roi), gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = frame(roi);
+    }
+    int cell_w = gray.cols / latency_grid;
+    int cell_h = gray.rows / latency_grid;
+    if (cell_w < 4 || cell_h < 4) return -1;
+
+    // 只取每格中間一半，避開格子邊緣的模糊和 rolling shutter 交界
+    double level[latency_grid * latency_grid];
+    double lo = 255.0, hi = 0.0;
+    for (int bit = 0; bit < latency_grid * latency_grid; ++bit) {
+        int gx = bit % latency_grid;
+        int gy = bit / latency_grid;
+        cv::Rect cell(gx * cell_w + cell_w / 4, gy * cell_h + cell_h / 4, cell_w / 2, cell_h / 2);
+        level[bit] = cv::mean(gray(cell))[0];
+        lo = std::min(lo, level[bit]);
+        hi = std::max(hi, level[bit]);
+    }
+    if (hi - lo < 32.0) return -1;      // 沒有對比，大概沒對準螢幕
+
+    double thresh = (lo + hi) / 2.0;
+    uint32_t code = 0;
+    for (int bit = 0; bit < latency_grid * latency_grid; ++bit) {
+        if (level[bit] > thresh) code |= 1u << bit;
+    }
+    uint32_t seq = code & 0xFF;
+    uint32_t inv = (code >> 8) & 0xFF;
+    if ((seq ^ inv) != 0xFF) return -1;
+    return (int)seq;
+}
+
+class latency_recorder
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    latency_recorder() : last_seen(-1), decode_failures(0)
+    {
+        for (int i = 0; i < 256; ++i) present_time[i] = clock::time_point();
+    }
+
+    void presented(uint32_t seq, clock::time_point t) { present_time[seq & 0xFF] = t; }
+
+    // 每個序號只在第一次被拍到時記一筆，同一個 pattern 連拍兩次不能重複計算
+    void observed(int seq, clock::time_point captured, clock::time_point now_presented)
+    {
+        if (seq < 0) {
+            decode_failures++;
+            return;
+        }
+        if (seq == last_seen) return;
+        last_seen = seq;
+        clock::time_point shown = present_time[seq];
+        if (shown == clock::time_point()) return;
+        g2g_ms.push_back(std::chrono::duration<double, std::milli>(now_presented - shown).count());
+        sw_ms.push_back(std::chrono::duration<double, std::milli>(now_presented - captured).count());
+    }
+
+    size_t sample_count() const { return g2g_ms.size(); }
+
+    void report(std::ostream &os) const
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "[g2g] %zu samples, %zu undecodable captures\n",
+                      g2g_ms.size(), decode_failures);
+        os << line;
+        print_row(os, "glass2glass", g2g_ms);
+        print_row(os, "capture2present", sw_ms);
+        print_histogram(os, g2g_ms);
+    }
+
+private:
+    static void print_row(std::ostream &os, const char *name, const std::vector<double> &v)
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-16s min %7.1f  p50 %7.1f  p95 %7.1f  max %7.1f ms\n", name,
+                      percentile(v, 0.0), percentile(v, 0.5), percentile(v, 0.95), percentile(v, 1.0));
+        os << line;
+    }
+
+    // 以 10 ms 為一格的文字直方圖
+    static void print_histogram(std::ostream &os, const std::vector<double> &v)
+    {
+        if (v.empty()) return;
+        const double bin_ms = 10.0;
+        int max_bin = (int)(*std::max_element(v.begin(), v.end()) / bin_ms);
+        std::vector<int> bins(max_bin + 1, 0);
+        for (double x : v) bins[(int)(x / bin_ms)]++;
+        int peak = *std::max_element(bins.begin(), bins.end());
+        char line[64];
+        for (int i = 0; i <= max_bin; ++i) {
+            if (bins[i] == 0) continue;
+            std::snprintf(line, sizeof(line), "%5d-%-5d ms %5d ", (int)(i * bin_ms), (int)((i + 1) * bin_ms), bins[i]);
+            os << line << std::string((size_t)(bins[i] * 40 / peak), '#') << "\n";
+        }
+    }
+
+    clock::time_point present_time[256];
+    int last_seen;
+    size_t decode_failures;
+    std::vector<double> g2g_ms;
+    std::vector<double> sw_ms;
+};
+
+// 記憶體裡的 framebuffer + 讀它的假 camera
+// delay_ms 模擬 display + camera 的硬體延遲，預設 0 就只剩軟體的部分
+class virtual_loopback
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit virtual_loopback(cv::Size size, double delay_ms = 0.0)
+        : frame_size(size), delay(delay_ms) {}
+
+    void present(const cv::Mat &bgr)
+    {
+        history.push_back(std::make_pair(clock::now(), bgr.clone()));
+        while (history.size() > 64) history.pop_front();
+    }
+
+    // 回傳 delay_ms 之前最後一張 present 的內容
+    bool read(cv::Mat &out)
+    {
+        clock::time_point cutoff = clock::now() - std::chrono::microseconds((int64_t)(delay * 1000.0));
+        const cv::Mat *latest = nullptr;
+        for (const auto &h : history) {
+            if (h.first <= cutoff) latest = &h.second;
+        }
+        if (!latest) {
+            out = cv::Mat::zeros(frame_size, CV_8UC3);
+            return true;
+        }
+        latest->copyTo(out);
+        return true;
+    }
+
+private:
+    cv::Size frame_size;
+    double delay;
+    std::deque<std::pair<clock::time_point, cv::Mat> > history;
+};
+
+#endif // LATENCY_PROBE_H
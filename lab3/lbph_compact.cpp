@@ -0,0 +1,292 @@
+// 把二進位模型每個人的 histogram 用 k-medoids (chi-square 距離) 縮成最多 k 個代表樣本
+// lbph_train 把每張照片偵測到的每張臉都存進模型，同一個人有很多幾乎一樣的 histogram，
+// predict 的時間和樣本數成正比。medoid 是真的訓練樣本，不是平均出來的 histogram，
+// 所以 uint8 模型也能照樣存。
+// 用法：
+//   ./lbph_compact <model.bin> <out.bin> [--k 8] [--curve 1,2,4,8,16,0] [--test <face_dir> | --holdout 5]
+// --curve 列出每個 k 的模型大小、正確率和平均 predict 時間 (0 = 不壓縮)：
+//   --test 拿資料夾裡的臉測 (檔名 <名字>_xxx.jpg，例如 lbph_train 存的 ./face，名字要在模型裡)；
+//   沒給就每個人每 holdout 個樣本留一個當測試，用剩下的壓縮 (模型裡的樣本本來就是訓練資料，直接測一定對)。
+// 最後輸出的模型用全部樣本以 --k 壓縮。
+#include <cfloat>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "lbph_engine.h"
+
+struct gallery
+{
+    std::vector<int> labels;
+    std::vector<float> rows;    // 每列 dims 個 float
+};
+
+// 模型的第 i 個樣本 → dims 個 float
+void model_row(const lbph_model &model, int i, float *out)
+{
+    if (model.dtype() == LBPH_U8) {
+        const float scale = (float)(1.0 / model.header().cell_pixels);
+        const uint8_t *c = model.counts(i);
+        for (int j = 0; j < model.dims(); ++j) out[j] = (float)c[j] * scale;
+    } else {
+        std::copy(model.histogram(i), model.histogram(i) + model.dims(), out);
+    }
+}
+
+// 一個人的 n 個樣本 (dist 是 n x n 的距離) 選出 k 個 medoid，回傳它們的 index。
+// 初始值用 k-means++ 的方式 (固定亂數種子，每次結果一樣)，再交替「分群 → 每群重選 medoid」到不變為止
+std::vector<int> k_medoids(const std::vector<double> &dist, int n, int k)
+{
+    std::vector<int> medoids;
+    if (k >= n) {
+        medoids.resize(n);
+        std::iota(medoids.begin(), medoids.end(), 0);
+        return medoids;
+    }
+    cv::RNG rng(12345);
+
+    // 第一個是到其他樣本距離和最小的，之後依到最近 medoid 的距離平方的比例抽
+    int first = 0;
+    double best_sum = DBL_MAX;
+    for (int i = 0; i < n; ++i) {
+        double sum = 0.0;
+        for (int j = 0; j < n; ++j) sum += dist[(size_t)i * n + j];
+        if (sum < best_sum) {
+            best_sum = sum;
+            first = i;
+        }
+    }
+    medoids.push_back(first);
+    std::vector<double> nearest(n);
+    for (int i = 0; i < n; ++i) nearest[i] = dist[(size_t)i * n + first];
+    while ((int)medoids.size() < k) {
+        double total = 0.0;
+        for (int i = 0; i < n; ++i) total += nearest[i] * nearest[i];
+        int pick = -1;
+        if (total > 0.0) {
+            double r = rng.uniform(0.0, total);
+            for (int i = 0; i < n && pick < 0; ++i) {
+                r -= nearest[i] * nearest[i];
+                if (r <= 0.0 && nearest[i] > 0.0) pick = i;
+            }
+        }
+        if (pick < 0) {
+            // 剩下的樣本都和 medoid 一模一樣，隨便補一個還沒選的
+            for (int i = 0; i < n && pick < 0; ++i) {
+                if (std::find(medoids.begin(), medoids.end(), i) == medoids.end()) pick = i;
+            }
+        }
+        medoids.push_back(pick);
+        for (int i = 0; i < n; ++i) nearest[i] = std::min(nearest[i], dist[(size_t)i * n + pick]);
+    }
+
+    std::vector<int> assign(n, -1);
+    for (int iter = 0; iter < 50; ++iter) {
+        bool changed = false;
+        for (int i = 0; i < n; ++i) {
+            int best = 0;
+            for (int c = 1; c < k; ++c) {
+                if (dist[(size_t)i * n + medoids[c]] < dist[(size_t)i * n + medoids[best]]) best = c;
+            }
+            if (assign[i] != best) {
+                assign[i] = best;
+                changed = true;
+            }
+        }
+        if (!changed && iter > 0) break;
+        // 每一群換成到同群其他樣本距離和最小的那個
+        for (int c = 0; c < k; ++c) {
+            double best_cost = DBL_MAX;
+            for (int i = 0; i < n; ++i) {
+                if (assign[i] != c) continue;
+                double cost = 0.0;
+                for (int j = 0; j < n; ++j) {
+                    if (assign[j] == c) cost += dist[(size_t)i * n + j];
+                }
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    medoids[c] = i;
+                }
+            }
+        }
+    }
+    std::sort(medoids.begin(), medoids.end());
+    return medoids;
+}
+
+// 每個人各自分群的距離矩陣 (label → (樣本 index, n x n 距離))，k 不同時可以重複用
+struct class_distances
+{
+    std::vector<int> members;
+    std::vector<double> dist;
+};
+
+std::map<int, class_distances> build_distances(const gallery &g, int dims)
+{
+    std::map<int, class_distances> out;
+    for (size_t i = 0; i < g.labels.size(); ++i) out[g.labels[i]].members.push_back((int)i);
+    for (auto &c : out) {
+        const std::vector<int> &m = c.second.members;
+        const size_t n = m.size();
+        c.second.dist.assign(n * n, 0.0);
+        for (size_t a = 0; a < n; ++a) {
+            for (size_t b = a + 1; b < n; ++b) {
+                double d = lbph_chisqr(&g.rows[(size_t)m[a] * dims], &g.rows[(size_t)m[b] * dims], dims);
+                c.second.dist[a * n + b] = c.second.dist[b * n + a] = d;
+            }
+        }
+    }
+    return out;
+}
+
+// 每個人最多 k 個 medoid (k <= 0 時全部保留)
+gallery compact(const gallery &g, const std::map<int, class_distances> &classes, int dims, int k)
+{
+    gallery out;
+    for (const auto &c : classes) {
+        const std::vector<int> &m = c.second.members;
+        std::vector<int> keep = k_medoids(c.second.dist, (int)m.size(), k > 0 ? k : (int)m.size());
+        for (int idx : keep) {
+            out.labels.push_back(c.first);
+            out.rows.insert(out.rows.end(), g.rows.begin() + (size_t)m[idx] * dims, g.rows.begin() + (size_t)(m[idx] + 1) * dims);
+        }
+    }
+    return out;
+}
+
+std::vector<int> parse_list(const std::string &arg)
+{
+    std::vector<int> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) out.push_back(atoi(item.c_str()));
+    return out;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model.bin> <out.bin> [--k N] [--curve k1,k2,...]"
+                  << " [--test <face_dir> | --holdout N]" << std::endl;
+        return 1;
+    }
+    std::string in_path = argv[1], out_path = argv[2], test_dir;
+    int k = 8, holdout = 5;
+    std::vector<int> curve = { 1, 2, 4, 8, 16, 0 };
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--k" && i + 1 < argc) {
+            k = atoi(argv[++i]);
+        } else if (arg == "--curve" && i + 1 < argc) {
+            curve = parse_list(argv[++i]);
+        } else if (arg == "--test" && i + 1 < argc) {
+            test_dir = argv[++i];
+        } else if (arg == "--holdout" && i + 1 < argc) {
+            holdout = std::max(2, atoi(argv[++i]));
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    lbph_engine source;
+    if (!source.load(in_path)) {
+        std::cerr << "Error: Cannot load " << in_path << ": " << source.last_error() << std::endl;
+        return 1;
+    }
+    const lbph_model &model = source.data();
+    if (source.enrolled() > 0) {
+        std::cerr << "Warning: " << lbph_journal_path(in_path) << " is not compacted, merge it with save first" << std::endl;
+    }
+    const int dims = model.dims(), stride = model.stride();
+    const lbph_params params = lbph_params_from_header(model.header());
+    const std::map<int, std::string> names = source.names();
+
+    gallery all;
+    all.labels.resize(model.count());
+    all.rows.resize((size_t)model.count() * dims);
+    for (int i = 0; i < model.count(); ++i) {
+        all.labels[i] = model.label(i);
+        model_row(model, i, &all.rows[(size_t)i * dims]);
+    }
+
+    // 測試資料：資料夾的臉，或從模型裡每個人留一部分
+    gallery train, test;
+    if (!test_dir.empty()) {
+        train = all;
+        std::vector<float> hist;
+        for (const auto &entry : std::filesystem::directory_iterator(test_dir)) {
+            cv::Mat face = cv::imread(entry.path().string(), cv::IMREAD_GRAYSCALE);
+            if (face.empty()) continue;
+            std::string stem = entry.path().stem().string();
+            int label = source.label_of(stem.substr(0, stem.find('_')));
+            if (label < 0) continue;
+            source.compute_histogram(face, hist);
+            test.labels.push_back(label);
+            test.rows.insert(test.rows.end(), hist.begin(), hist.begin() + dims);
+        }
+    } else {
+        std::map<int, int> seen;
+        for (size_t i = 0; i < all.labels.size(); ++i) {
+            gallery &dst = (++seen[all.labels[i]] % holdout == 0) ? test : train;
+            dst.labels.push_back(all.labels[i]);
+            dst.rows.insert(dst.rows.end(), all.rows.begin() + i * dims, all.rows.begin() + (i + 1) * dims);
+        }
+    }
+    if (test.labels.empty()) {
+        std::cerr << "Warning: No test faces, accuracy is not reported" << std::endl;
+    }
+
+    // 正確率 vs 大小：每個 k 寫成暫存模型，用 lbph_engine predict (和板子上一樣的路徑)
+    std::map<int, class_distances> train_classes = build_distances(train, dims);
+    std::string tmp_path = out_path + ".curve";
+    std::cout << "k, samples, bytes, accuracy, avg predict ms" << std::endl;
+    for (int ck : curve) {
+        gallery g = compact(train, train_classes, dims, ck);
+        if (!lbph_write_model(tmp_path, params, g.labels, g.rows.data(), names)) {
+            std::cerr << "Error: Cannot write " << tmp_path << std::endl;
+            return 1;
+        }
+        lbph_engine engine;
+        if (!engine.load(tmp_path)) {
+            std::cerr << "Error: " << engine.last_error() << std::endl;
+            return 1;
+        }
+        const size_t bytes = engine.data().header().file_size;
+        int correct = 0;
+        double ms = 0.0;
+        std::vector<float> query(stride, 0.0f);
+        for (size_t t = 0; t < test.labels.size(); ++t) {
+            std::copy(test.rows.begin() + t * dims, test.rows.begin() + (t + 1) * dims, query.begin());
+            int label = -1;
+            double dist = DBL_MAX;
+            auto t0 = std::chrono::steady_clock::now();
+            engine.predict_histogram(&query[0], label, dist);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            if (label == test.labels[t]) correct++;
+        }
+        double accuracy = test.labels.empty() ? 0.0 : 100.0 * correct / test.labels.size();
+        std::cout << (ck > 0 ? std::to_string(ck) : std::string("all")) << ", " << g.labels.size() << ", " << bytes << ", "
+                  << cv::format("%.2f%%", accuracy) << ", "
+                  << cv::format("%.3f", test.labels.empty() ? 0.0 : ms / test.labels.size()) << std::endl;
+    }
+    std::remove(tmp_path.c_str());
+
+    // --test 時訓練資料就是全部樣本，距離不用重算
+    gallery out = compact(all, test_dir.empty() ? build_distances(all, dims) : train_classes, dims, k);
+    if (!lbph_write_model(out_path, params, out.labels, out.rows.data(), names)) {
+        std::cerr << "Error: Cannot write " << out_path << std::endl;
+        return 1;
+    }
+    std::cout << "Compacted " << all.labels.size() << " samples to " << out.labels.size()
+              << " (k = " << k << ") in " << out_path << std::endl;
+    return 0;
+}
@@ -0,0 +1,152 @@
+// 把 OpenCV 存的 LBPH YAML 模型轉成 lbph_model.h 的二進位格式 (板子上 mmap 直接用)
+// 用法：
+//   ./lbph_convert <model.yml> <model.bin> [--names 0=313551166,1=313551170] [--verify <face_dir>]
+//                  [--u8 [--cell-pixels 144]]
+// 沒給 --names 時用模型裡的 labelsInfo (lbph_train 存的模型沒有)。
+// --u8 把 histogram 存成每格的 pixel 數 (1/4 大小，predict 結果不變)，
+// --cell-pixels 是訓練臉每格的 pixel 數 (100x100 的臉、8x8 格是 12x12 = 144)。
+// --verify 拿資料夾裡的臉 (例如 lbph_train 存的 ./face) 分別用 OpenCV 和 lbph_engine predict，
+// 比對 label 和距離是否完全相同。
+// (PC 上的 OpenCV compareHist 有 SIMD 路徑，距離可能差在最後幾個 bit；板子上是純 C 路徑，應該完全相同)
+#include <cfloat>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/face.hpp>
+
+#include "lbph_engine.h"
+
+// "0=Shark,1=Wilson" → map
+bool parse_names(const std::string &arg, std::map<int, std::string> &names)
+{
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq == 0) return false;
+        names[atoi(item.substr(0, eq).c_str())] = item.substr(eq + 1);
+    }
+    return true;
+}
+
+// 回傳不一致的張數
+int verify(const cv::Ptr<cv::face::LBPHFaceRecognizer> &recognizer, const std::string &bin_path, const std::string &dir)
+{
+    lbph_engine engine;
+    if (!engine.load(bin_path)) {
+        std::cerr << "Error: " << engine.last_error() << std::endl;
+        return 1;
+    }
+    int total = 0, label_diff = 0, dist_diff = 0;
+    double max_diff = 0.0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+        cv::Mat face = cv::imread(entry.path().string(), cv::IMREAD_GRAYSCALE);
+        if (face.empty()) continue;
+        int l0 = -1, l1 = -1;
+        double d0 = DBL_MAX, d1 = DBL_MAX;
+        recognizer->predict(face, l0, d0);
+        engine.predict(face, l1, d1);
+        total++;
+        if (l0 != l1) label_diff++;
+        if (d0 != d1) {
+            dist_diff++;
+            max_diff = std::max(max_diff, std::fabs(d0 - d1));
+        }
+    }
+    std::cout << "Verified " << total << " faces: " << label_diff << " label mismatches, "
+              << dist_diff << " distance mismatches (max diff " << max_diff << ")" << std::endl;
+    return label_diff;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model.yml> <model.bin> [--names label=name,...] [--verify <face_dir>]"
+                  << " [--u8 [--cell-pixels N]]" << std::endl;
+        return 1;
+    }
+    std::string in_path = argv[1], out_path = argv[2], verify_dir;
+    std::map<int, std::string> names;
+    lbph_params params;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--names" && i + 1 < argc) {
+            if (!parse_names(argv[++i], names)) {
+                std::cerr << "Error: Bad --names value: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--verify" && i + 1 < argc) {
+            verify_dir = argv[++i];
+        } else if (arg == "--u8") {
+            params.dtype = LBPH_U8;
+        } else if (arg == "--cell-pixels" && i + 1 < argc) {
+            params.cell_pixels = atoi(argv[++i]);
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    cv::Ptr<cv::face::LBPHFaceRecognizer> recognizer = cv::face::LBPHFaceRecognizer::create();
+    try {
+        recognizer->read(in_path);
+    } catch (const cv::Exception &e) {
+        std::cerr << "Error: Cannot load LBPH model " << in_path << ": " << e.what() << std::endl;
+        return 1;
+    }
+    std::vector<cv::Mat> hists = recognizer->getHistograms();
+    cv::Mat labels_mat = recognizer->getLabels();
+    if (hists.empty() || (int)labels_mat.total() != (int)hists.size()) {
+        std::cerr << "Error: " << in_path << " has no trained histograms." << std::endl;
+        return 1;
+    }
+
+    params.radius = recognizer->getRadius();
+    params.neighbors = recognizer->getNeighbors();
+    params.grid_x = recognizer->getGridX();
+    params.grid_y = recognizer->getGridY();
+    params.threshold = recognizer->getThreshold();
+    int dims = params.grid_x * params.grid_y * lbph_bin_count(params.neighbors, false);
+
+    std::vector<int> labels;
+    std::vector<float> data;
+    data.reserve((size_t)dims * hists.size());
+    for (size_t i = 0; i < hists.size(); ++i) {
+        cv::Mat h = hists[i].reshape(1, 1);
+        if (h.type() != CV_32F || (int)h.total() != dims) {
+            std::cerr << "Error: Histogram " << i << " has unexpected size " << h.total() << std::endl;
+            return 1;
+        }
+        if (!h.isContinuous()) h = h.clone();
+        data.insert(data.end(), h.ptr<float>(), h.ptr<float>() + dims);
+        labels.push_back(labels_mat.at<int>((int)i));
+        if (!names.count(labels.back())) {
+            std::string info = recognizer->getLabelInfo(labels.back());
+            if (!info.empty()) names[labels.back()] = info;
+        }
+    }
+
+    if (!lbph_write_model(out_path, params, labels, &data[0], names)) {
+        std::cerr << "Error: Cannot write " << out_path;
+        if (params.dtype == LBPH_U8) std::cerr << " (histograms are not counts over " << params.cell_pixels << " pixels?)";
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // 讀回來確認
+    lbph_model check;
+    if (!check.open(out_path)) {
+        std::cerr << "Error: " << out_path << " failed to verify: " << check.last_error() << std::endl;
+        return 1;
+    }
+    std::cout << "Converted " << labels.size() << " histograms (" << dims << " dims, "
+              << names.size() << " names) to " << out_path << std::endl;
+    if (!verify_dir.empty() && verify(recognizer, out_path, verify_dir) != 0) return 1;
+    return 0;
+}
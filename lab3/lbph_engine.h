@@ -0,0 +1,1081 @@
+#ifndef LBPH_ENGINE_H
+#define LBPH_ENGINE_H
+
+// 直接用 lbph_model (mmap) 做 LBPH predict
+// cv::face::LBPHFaceRecognizer 只能從 YAML read() 或 train() 拿到 histogram，
+// 沒辦法把 mmap 的資料交給它，所以 predict 在這裡照 OpenCV 的做法重寫一次：
+//   elbp → spatial histogram → 和每個訓練樣本算 HISTCMP_CHISQR_ALT → 取最小
+// 每一步的運算型別和順序都和 OpenCV (板子上的純 C 路徑) 相同，
+// 同一張臉算出來的 label 和距離和 LBPHFaceRecognizer::predict 一樣。
+//
+// 最花時間的是和每個樣本算 chi-square (16384 維 x 樣本數)。先用 NEON / SSE2 / AVX2
+// 以 float 一次算 4~8 個 bin 掃過所有樣本，每 256 個 bin 的部分和再加到 double，
+// 相對誤差在 1e-6 以下；距離在最小值 (1 + lbph_rescore_margin) 倍以內的樣本
+// 再用和 OpenCV 相同的 double 版本重算一次決定答案，所以結果還是和 OpenCV 一模一樣。
+//
+// 樣本很多時不用每個都算完：
+//   - 每 32 個相鄰 bin 加起來得到粗的 histogram，粗 histogram 的 chi-square 一定不大於原本的
+//     (Σa²/b ≥ (Σa)²/Σb)，先用它當下界把樣本由小排到大
+//   - 依序算，下界已經超過目前最小距離就停，後面的都不可能更小
+//   - 每算完 256 個 bin 檢查一次，部分和已經超過目前最小距離就放棄這個樣本
+// 被跳過的樣本真正的距離一定比最小值大，所以答案不變。
+//
+// 定義 LBPH_NO_SIMD 可以強制用純 C++ 版本
+
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "lbph_model.h"
+
+#if !defined(LBPH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define LBPH_USE_NEON 1
+#elif !defined(LBPH_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define LBPH_USE_AVX2 1
+#elif !defined(LBPH_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LBPH_USE_SSE2 1
+#endif
+
+// float 距離和最小值差不到這個比例的樣本要用 double 重算 (實際的 float 誤差在 1e-6 以下)
+const double lbph_rescore_margin = 1e-4;
+
+// 粗 histogram 每格合併幾個 bin
+const int lbph_coarse_group = 32;
+
+inline int lbph_coarse_stride(int stride)
+{
+    return (int)lbph_align((stride + lbph_coarse_group - 1) / lbph_coarse_group, 16);
+}
+
+// stride 個 float → lbph_coarse_stride(stride) 個，每個是相鄰 lbph_coarse_group 個 bin 的和
+inline void lbph_coarsen(const float *hist, int stride, float *out)
+{
+    const int n = lbph_coarse_stride(stride);
+    for (int g = 0; g < n; ++g) {
+        double sum = 0.0;
+        for (int j = g * lbph_coarse_group; j < std::min((g + 1) * lbph_coarse_group, stride); ++j) sum += hist[j];
+        out[g] = (float)sum;
+    }
+}
+
+// 圓周上第 n 個取樣點的整數位移和雙線性權重 (和 OpenCV elbp_ 的算法一樣)
+struct lbph_sample
+{
+    int fx, fy, cx, cy;
+    float w1, w2, w3, w4;
+    // 上下左右四個點的權重其實全落在一個 pixel (dx, dy) 上，另外三個小到加上去也到不了 0.25，
+    // 這時內插再比大小的結果就等於直接比 byte：pixel >= center
+    bool exact;
+    int dx, dy;
+};
+
+inline lbph_sample lbph_sampling(int radius, int neighbors, int n)
+{
+    lbph_sample s;
+    float x = (float)(radius * std::cos(2.0 * CV_PI * n / (float)neighbors));
+    float y = (float)(-radius * std::sin(2.0 * CV_PI * n / (float)neighbors));
+    s.fx = (int)std::floor(x);
+    s.fy = (int)std::floor(y);
+    s.cx = (int)std::ceil(x);
+    s.cy = (int)std::ceil(y);
+    float ty = y - s.fy, tx = x - s.fx;
+    s.w1 = (1 - tx) * (1 - ty);
+    s.w2 = tx * (1 - ty);
+    s.w3 = (1 - tx) * ty;
+    s.w4 = tx * ty;
+
+    const float w[4] = { s.w1, s.w2, s.w3, s.w4 };
+    const int ox[4] = { s.fx, s.cx, s.fx, s.cx }, oy[4] = { s.fy, s.fy, s.cy, s.cy };
+    s.exact = false;
+    s.dx = s.dy = 0;
+    for (int k = 0; k < 4; ++k) {
+        if (w[k] != 1.0f) continue;
+        double rest = (double)w[0] + w[1] + w[2] + w[3] - 1.0;
+        if (rest * 255.0 < 0.25) {
+            s.exact = true;
+            s.dx = ox[k];
+            s.dy = oy[k];
+        }
+    }
+    return s;
+}
+
+// 一個 pixel 的 code (y, x 是 src 座標)
+inline int lbph_code_at(const cv::Mat &src, int y, int x, const lbph_sample *s, int neighbors)
+{
+    const int c = src.ptr<uchar>(y)[x];
+    int code = 0;
+    for (int n = 0; n < neighbors; ++n) {
+        const lbph_sample &p = s[n];
+        const uchar *r0 = src.ptr<uchar>(y + p.fy), *r1 = src.ptr<uchar>(y + p.cy);
+        float t = (float)(p.w1 * r0[x + p.fx] + p.w2 * r0[x + p.cx] + p.w3 * r1[x + p.fx] + p.w4 * r1[x + p.cx]);
+        code += ((t > c) || (std::abs(t - c) < std::numeric_limits<float>::epsilon())) << n;
+    }
+    return code;
+}
+
+// 和 OpenCV elbp_ 相同：圓周上 neighbors 個點雙線性內插，codes 是 (rows-2r) x (cols-2r) 的 CV_32S
+inline void lbph_codes(const cv::Mat &src, int radius, int neighbors, cv::Mat &codes)
+{
+    codes.create(src.rows - 2 * radius, src.cols - 2 * radius, CV_32S);
+    std::vector<lbph_sample> s(neighbors);
+    for (int n = 0; n < neighbors; ++n) s[n] = lbph_sampling(radius, neighbors, n);
+    for (int i = 0; i < codes.rows; ++i) {
+        int *out = codes.ptr<int>(i);
+        for (int j = 0; j < codes.cols; ++j) out[j] = lbph_code_at(src, i + radius, j + radius, &s[0], neighbors);
+    }
+}
+
+#if defined(LBPH_USE_NEON)
+// 16 個 pixel 的內插結果 >= center 的 mask，float 運算的順序和 lbph_code_at 相同
+static inline uint8x16_t lbph_interp_mask(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d,
+                                          uint8x16_t center, const lbph_sample &p)
+{
+    const float32x4_t w1 = vdupq_n_f32(p.w1), w2 = vdupq_n_f32(p.w2), w3 = vdupq_n_f32(p.w3), w4 = vdupq_n_f32(p.w4);
+    const float32x4_t eps = vdupq_n_f32(std::numeric_limits<float>::epsilon());
+    uint16x8_t half[2];
+    for (int h = 0; h < 2; ++h) {
+        uint16x8_t a16 = vmovl_u8(h ? vget_high_u8(a) : vget_low_u8(a));
+        uint16x8_t b16 = vmovl_u8(h ? vget_high_u8(b) : vget_low_u8(b));
+        uint16x8_t c16 = vmovl_u8(h ? vget_high_u8(c) : vget_low_u8(c));
+        uint16x8_t d16 = vmovl_u8(h ? vget_high_u8(d) : vget_low_u8(d));
+        uint16x8_t z16 = vmovl_u8(h ? vget_high_u8(center) : vget_low_u8(center));
+        uint16x4_t quarter[2];
+        for (int q = 0; q < 2; ++q) {
+#define LBPH_F32(v) vcvtq_f32_u32(vmovl_u16(q ? vget_high_u16(v) : vget_low_u16(v)))
+            float32x4_t t = vmulq_f32(w1, LBPH_F32(a16));
+            t = vaddq_f32(t, vmulq_f32(w2, LBPH_F32(b16)));
+            t = vaddq_f32(t, vmulq_f32(w3, LBPH_F32(c16)));
+            t = vaddq_f32(t, vmulq_f32(w4, LBPH_F32(d16)));
+            float32x4_t z = LBPH_F32(z16);
+#undef LBPH_F32
+            uint32x4_t m = vorrq_u32(vcgtq_f32(t, z), vcltq_f32(vabsq_f32(vsubq_f32(t, z)), eps));
+            quarter[q] = vmovn_u32(m);
+        }
+        half[h] = vcombine_u16(quarter[0], quarter[1]);
+    }
+    return vcombine_u8(vmovn_u16(half[0]), vmovn_u16(half[1]));
+}
+#elif defined(LBPH_USE_SSE2) || defined(LBPH_USE_AVX2)
+static inline __m128i lbph_interp_mask(__m128i a, __m128i b, __m128i c, __m128i d,
+                                       __m128i center, const lbph_sample &p)
+{
+    const __m128 w1 = _mm_set1_ps(p.w1), w2 = _mm_set1_ps(p.w2), w3 = _mm_set1_ps(p.w3), w4 = _mm_set1_ps(p.w4);
+    const __m128 eps = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i half[2];
+    for (int h = 0; h < 2; ++h) {
+        __m128i a16 = h ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+        __m128i b16 = h ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+        __m128i c16 = h ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+        __m128i d16 = h ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+        __m128i z16 = h ? _mm_unpackhi_epi8(center, zero) : _mm_unpacklo_epi8(center, zero);
+        __m128i quarter[2];
+        for (int q = 0; q < 2; ++q) {
+#define LBPH_F32(v) _mm_cvtepi32_ps(q ? _mm_unpackhi_epi16(v, zero) : _mm_unpacklo_epi16(v, zero))
+            __m128 t = _mm_mul_ps(w1, LBPH_F32(a16));
+            t = _mm_add_ps(t, _mm_mul_ps(w2, LBPH_F32(b16)));
+            t = _mm_add_ps(t, _mm_mul_ps(w3, LBPH_F32(c16)));
+            t = _mm_add_ps(t, _mm_mul_ps(w4, LBPH_F32(d16)));
+            __m128 z = LBPH_F32(z16);
+#undef LBPH_F32
+            __m128 m = _mm_or_ps(_mm_cmpgt_ps(t, z), _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(t, z), abs_mask), eps));
+            quarter[q] = _mm_castps_si128(m);
+        }
+        half[h] = _mm_packs_epi32(quarter[0], quarter[1]);     // -1 / 0 飽和之後還是 -1 / 0
+    }
+    return _mm_packs_epi16(half[0], half[1]);
+}
+#endif
+
+// lbph_codes 的 8-bit 版本 (neighbors <= 8)，結果完全相同。
+// 一次 16 個 pixel：上下左右四個點直接比 byte，斜的四個點轉成 float 照同樣的順序內插
+inline void lbph_codes_u8(const cv::Mat &src, int radius, int neighbors, cv::Mat &codes)
+{
+    codes.create(src.rows - 2 * radius, src.cols - 2 * radius, CV_8U);
+    lbph_sample s[8];
+    for (int n = 0; n < neighbors; ++n) s[n] = lbph_sampling(radius, neighbors, n);
+    for (int i = 0; i < codes.rows; ++i) {
+        const int y = i + radius;
+        uchar *out = codes.ptr<uchar>(i);
+        int j = 0;
+#if defined(LBPH_USE_NEON) || defined(LBPH_USE_SSE2) || defined(LBPH_USE_AVX2)
+        const uchar *center = src.ptr<uchar>(y) + radius;
+#endif
+#if defined(LBPH_USE_NEON)
+        for (; j + 16 <= codes.cols; j += 16) {
+            const int x = j + radius;
+            uint8x16_t c = vld1q_u8(center + j), code = vdupq_n_u8(0);
+            for (int n = 0; n < neighbors; ++n) {
+                const lbph_sample &p = s[n];
+                uint8x16_t m;
+                if (p.exact) {
+                    m = vcgeq_u8(vld1q_u8(src.ptr<uchar>(y + p.dy) + x + p.dx), c);
+                } else {
+                    const uchar *r0 = src.ptr<uchar>(y + p.fy) + x, *r1 = src.ptr<uchar>(y + p.cy) + x;
+                    m = lbph_interp_mask(vld1q_u8(r0 + p.fx), vld1q_u8(r0 + p.cx),
+                                         vld1q_u8(r1 + p.fx), vld1q_u8(r1 + p.cx), c, p);
+                }
+                code = vorrq_u8(code, vandq_u8(m, vdupq_n_u8((uint8_t)(1 << n))));
+            }
+            vst1q_u8(out + j, code);
+        }
+#elif defined(LBPH_USE_SSE2) || defined(LBPH_USE_AVX2)
+        for (; j + 16 <= codes.cols; j += 16) {
+            const int x = j + radius;
+            __m128i c = _mm_loadu_si128((const __m128i *)(center + j)), code = _mm_setzero_si128();
+            for (int n = 0; n < neighbors; ++n) {
+                const lbph_sample &p = s[n];
+                __m128i m;
+                if (p.exact) {
+                    __m128i v = _mm_loadu_si128((const __m128i *)(src.ptr<uchar>(y + p.dy) + x + p.dx));
+                    m = _mm_cmpeq_epi8(_mm_max_epu8(v, c), v);     // SSE2 沒有無號 >=
+                } else {
+                    const uchar *r0 = src.ptr<uchar>(y + p.fy) + x, *r1 = src.ptr<uchar>(y + p.cy) + x;
+                    m = lbph_interp_mask(_mm_loadu_si128((const __m128i *)(r0 + p.fx)),
+                                         _mm_loadu_si128((const __m128i *)(r0 + p.cx)),
+                                         _mm_loadu_si128((const __m128i *)(r1 + p.fx)),
+                                         _mm_loadu_si128((const __m128i *)(r1 + p.cx)), c, p);
+                }
+                code = _mm_or_si128(code, _mm_and_si128(m, _mm_set1_epi8((char)(1 << n))));
+            }
+            _mm_storeu_si128((__m128i *)(out + j), code);
+        }
+#endif
+        for (; j < codes.cols; ++j) out[j] = (uchar)lbph_code_at(src, y, j + radius, s, neighbors);
+    }
+}
+
+// uniform LBP 的查表：圓周上 0/1 切換不超過 2 次的 code 依大小各分一個 bin，其他都放最後一個 bin
+inline std::vector<int> lbph_uniform_table(int neighbors)
+{
+    const int n = 1 << neighbors;
+    const int other = lbph_bin_count(neighbors, true) - 1;
+    std::vector<int> table(n);
+    int next = 0;
+    for (int code = 0; code < n; ++code) {
+        int rotated = ((code >> 1) | ((code & 1) << (neighbors - 1)));
+        int changes = 0;
+        for (int x = code ^ rotated; x; x &= x - 1) changes++;
+        table[code] = changes <= 2 ? next++ : other;
+    }
+    return table;
+}
+
+// 和 OpenCV spatial_histogram 相同：grid_x x grid_y 格，每格 bins 個 bin 除以格子的 pixel 數，
+// 右邊和下面除不盡的 pixel 不算。hist 要有 grid_x * grid_y * bins 個 float。
+// mapping 不是 nullptr 時先查表把 code 換成 bin (uniform LBP)。
+// 相鄰的 pixel 輪流加到 4 份 histogram，連續相同的 code 才不會卡在同一個位置的讀寫相依
+template <typename T>
+inline void lbph_spatial_histogram(const cv::Mat &codes, int bins, int grid_x, int grid_y, float *hist,
+                                   const int *mapping = nullptr)
+{
+    int width = codes.cols / grid_x, height = codes.rows / grid_y;
+    std::vector<int> count(4 * bins);
+    int *c0 = &count[0], *c1 = c0 + bins, *c2 = c1 + bins, *c3 = c2 + bins;
+    float scale = (float)(1.0 / (width * height));
+    for (int gy = 0; gy < grid_y; ++gy) {
+        for (int gx = 0; gx < grid_x; ++gx) {
+            std::fill(count.begin(), count.end(), 0);
+            for (int i = gy * height; i < (gy + 1) * height; ++i) {
+                const T *p = codes.ptr<T>(i) + gx * width;
+                int j = 0;
+                if (mapping) {
+                    for (; j + 4 <= width; j += 4) {
+                        c0[mapping[p[j]]]++;
+                        c1[mapping[p[j + 1]]]++;
+                        c2[mapping[p[j + 2]]]++;
+                        c3[mapping[p[j + 3]]]++;
+                    }
+                    for (; j < width; ++j) c0[mapping[p[j]]]++;
+                } else {
+                    for (; j + 4 <= width; j += 4) {
+                        c0[p[j]]++;
+                        c1[p[j + 1]]++;
+                        c2[p[j + 2]]++;
+                        c3[p[j + 3]]++;
+                    }
+                    for (; j < width; ++j) c0[p[j]]++;
+                }
+            }
+            for (int b = 0; b < bins; ++b) hist[b] = (float)(c0[b] + c1[b] + c2[b] + c3[b]) * scale;
+            hist += bins;
+        }
+    }
+}
+
+// 一張臉的 LBPH 特徵 (訓練和 predict 共用)，hist 要有 h.dims 個 float
+inline void lbph_histogram(const cv::Mat &face, const lbph_file_header &h, const int *mapping, float *hist)
+{
+    cv::Mat src = face, codes;
+    if (src.channels() == 3) cv::cvtColor(face, src, cv::COLOR_BGR2GRAY);
+    if (h.neighbors <= 8) {
+        lbph_codes_u8(src, h.radius, h.neighbors, codes);
+        lbph_spatial_histogram<uchar>(codes, h.bins, h.grid_x, h.grid_y, hist, mapping);
+    } else {
+        lbph_codes(src, h.radius, h.neighbors, codes);
+        lbph_spatial_histogram<int>(codes, h.bins, h.grid_x, h.grid_y, hist, mapping);
+    }
+}
+
+// compareHist(train, query, HISTCMP_CHISQR_ALT)
+inline double lbph_chisqr(const float *train, const float *query, int n)
+{
+    double result = 0.0;
+    for (int j = 0; j < n; ++j) {
+        double a = train[j] - query[j];
+        double b = train[j] + query[j];
+        if (std::fabs(b) > DBL_EPSILON) result += a * a / b;
+    }
+    return result * 2;
+}
+
+// 同樣的 chi-square 用 float 算，n 是 16 的倍數 (模型的 stride)，query 的尾巴要補 0。
+// b = 0 時 a 也是 0，分母換成 FLT_MIN 讓這一項是 0 而不是 NaN
+inline float lbph_chisqr_block(const float *train, const float *query, int n)
+{
+#if defined(LBPH_USE_NEON)
+    const float32x4_t tiny = vdupq_n_f32(FLT_MIN);
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = acc0;
+    for (int j = 0; j < n; j += 8) {
+        float32x4_t t0 = vld1q_f32(train + j), q0 = vld1q_f32(query + j);
+        float32x4_t t1 = vld1q_f32(train + j + 4), q1 = vld1q_f32(query + j + 4);
+        float32x4_t a0 = vsubq_f32(t0, q0), a1 = vsubq_f32(t1, q1);
+        float32x4_t b0 = vmaxq_f32(vaddq_f32(t0, q0), tiny), b1 = vmaxq_f32(vaddq_f32(t1, q1), tiny);
+        // ARMv7 沒有向量除法：倒數估計再做兩次 Newton-Raphson
+        float32x4_t r0 = vrecpeq_f32(b0), r1 = vrecpeq_f32(b1);
+        r0 = vmulq_f32(vrecpsq_f32(b0, r0), r0);
+        r1 = vmulq_f32(vrecpsq_f32(b1, r1), r1);
+        r0 = vmulq_f32(vrecpsq_f32(b0, r0), r0);
+        r1 = vmulq_f32(vrecpsq_f32(b1, r1), r1);
+        acc0 = vmlaq_f32(acc0, vmulq_f32(a0, a0), r0);
+        acc1 = vmlaq_f32(acc1, vmulq_f32(a1, a1), r1);
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#elif defined(LBPH_USE_AVX2)
+    const __m256 tiny = _mm256_set1_ps(FLT_MIN);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = acc0;
+    for (int j = 0; j < n; j += 16) {
+        __m256 t0 = _mm256_loadu_ps(train + j), q0 = _mm256_loadu_ps(query + j);
+        __m256 t1 = _mm256_loadu_ps(train + j + 8), q1 = _mm256_loadu_ps(query + j + 8);
+        __m256 a0 = _mm256_sub_ps(t0, q0), a1 = _mm256_sub_ps(t1, q1);
+        __m256 b0 = _mm256_max_ps(_mm256_add_ps(t0, q0), tiny), b1 = _mm256_max_ps(_mm256_add_ps(t1, q1), tiny);
+        acc0 = _mm256_add_ps(acc0, _mm256_div_ps(_mm256_mul_ps(a0, a0), b0));
+        acc1 = _mm256_add_ps(acc1, _mm256_div_ps(_mm256_mul_ps(a1, a1), b1));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#elif defined(LBPH_USE_SSE2)
+    const __m128 tiny = _mm_set1_ps(FLT_MIN);
+    __m128 acc0 = _mm_setzero_ps(), acc1 = acc0;
+    for (int j = 0; j < n; j += 8) {
+        __m128 t0 = _mm_loadu_ps(train + j), q0 = _mm_loadu_ps(query + j);
+        __m128 t1 = _mm_loadu_ps(train + j + 4), q1 = _mm_loadu_ps(query + j + 4);
+        __m128 a0 = _mm_sub_ps(t0, q0), a1 = _mm_sub_ps(t1, q1);
+        __m128 b0 = _mm_max_ps(_mm_add_ps(t0, q0), tiny), b1 = _mm_max_ps(_mm_add_ps(t1, q1), tiny);
+        acc0 = _mm_add_ps(acc0, _mm_div_ps(_mm_mul_ps(a0, a0), b0));
+        acc1 = _mm_add_ps(acc1, _mm_div_ps(_mm_mul_ps(a1, a1), b1));
+    }
+    __m128 s = _mm_add_ps(acc0, acc1);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#else
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int j = 0; j < n; j += 4) {
+        for (int k = 0; k < 4; ++k) {
+            float a = train[j + k] - query[j + k];
+            float b = std::max(train[j + k] + query[j + k], FLT_MIN);
+            acc[k] += a * a / b;
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+// 近似的 HISTCMP_CHISQR_ALT：每 256 個 bin (full 模型剛好一格) 的 float 部分和加到 double，
+// 累積誤差不會隨維度變大。部分和超過 bound 就不算了，回傳 DBL_MAX
+inline double lbph_chisqr_fast(const float *train, const float *query, int stride, double bound = DBL_MAX)
+{
+    double result = 0.0;
+    const double half_bound = bound * 0.5;
+    for (int j = 0; j < stride; j += 256) {
+        result += lbph_chisqr_block(train + j, query + j, std::min(256, stride - j));
+        if (result > half_bound) return DBL_MAX;
+    }
+    return result * 2;
+}
+
+// ---- uint8 (pixel 數) 模型 ----
+
+// 還原成 OpenCV 的 float 值 ((float)count * scale) 再算 compareHist，和 float 模型的 lbph_chisqr 完全相同
+inline double lbph_chisqr_u8(const uint8_t *train, float scale, const float *query, int n)
+{
+    double result = 0.0;
+    for (int j = 0; j < n; ++j) {
+        float t = (float)train[j] * scale;
+        double a = t - query[j];
+        double b = t + query[j];
+        if (std::fabs(b) > DBL_EPSILON) result += a * a / b;
+    }
+    return result * 2;
+}
+
+// pixel 數之間的 chi-square (float 累加)，n 是 16 的倍數。
+// 乘上 1 / cell_pixels 就是正規化 histogram 的距離；b = 0 時 a 也是 0，分母換成 1
+inline float lbph_chisqr_block_u8(const uint8_t *train, const uint8_t *query, int n)
+{
+#if defined(LBPH_USE_NEON)
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = acc0;
+    for (int j = 0; j < n; j += 16) {
+        uint8x16_t t = vld1q_u8(train + j), q = vld1q_u8(query + j);
+        uint8x16_t d = vabdq_u8(t, q);
+        uint16x8_t a2[2] = { vmull_u8(vget_low_u8(d), vget_low_u8(d)), vmull_u8(vget_high_u8(d), vget_high_u8(d)) };
+        uint16x8_t b[2] = { vaddl_u8(vget_low_u8(t), vget_low_u8(q)), vaddl_u8(vget_high_u8(t), vget_high_u8(q)) };
+        for (int h = 0; h < 2; ++h) {
+            float32x4_t a_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a2[h]))), a_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a2[h])));
+            float32x4_t b_lo = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(b[h]))), one);
+            float32x4_t b_hi = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(b[h]))), one);
+            float32x4_t r_lo = vrecpeq_f32(b_lo), r_hi = vrecpeq_f32(b_hi);
+            r_lo = vmulq_f32(vrecpsq_f32(b_lo, r_lo), r_lo);
+            r_hi = vmulq_f32(vrecpsq_f32(b_hi, r_hi), r_hi);
+            r_lo = vmulq_f32(vrecpsq_f32(b_lo, r_lo), r_lo);
+            r_hi = vmulq_f32(vrecpsq_f32(b_hi, r_hi), r_hi);
+            acc0 = vmlaq_f32(acc0, a_lo, r_lo);
+            acc1 = vmlaq_f32(acc1, a_hi, r_hi);
+        }
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#elif defined(LBPH_USE_SSE2) || defined(LBPH_USE_AVX2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 acc0 = _mm_setzero_ps(), acc1 = acc0;
+    for (int j = 0; j < n; j += 16) {
+        __m128i t = _mm_loadu_si128((const __m128i *)(train + j)), q = _mm_loadu_si128((const __m128i *)(query + j));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(t, q), _mm_subs_epu8(q, t));
+        for (int h = 0; h < 2; ++h) {
+            __m128i d16 = h ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+            __m128i a2 = _mm_mullo_epi16(d16, d16);     // 最大 255^2，當成無號數
+            __m128i b16 = _mm_add_epi16(h ? _mm_unpackhi_epi8(t, zero) : _mm_unpacklo_epi8(t, zero),
+                                        h ? _mm_unpackhi_epi8(q, zero) : _mm_unpacklo_epi8(q, zero));
+            __m128 a_lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(a2, zero)), a_hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(a2, zero));
+            __m128 b_lo = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b16, zero)), one);
+            __m128 b_hi = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(b16, zero)), one);
+            acc0 = _mm_add_ps(acc0, _mm_div_ps(a_lo, b_lo));
+            acc1 = _mm_add_ps(acc1, _mm_div_ps(a_hi, b_hi));
+        }
+    }
+    __m128 s = _mm_add_ps(acc0, acc1);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#else
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int j = 0; j < n; j += 4) {
+        for (int k = 0; k < 4; ++k) {
+            int a = (int)train[j + k] - (int)query[j + k];
+            int b = std::max((int)train[j + k] + (int)query[j + k], 1);
+            acc[k] += (float)(a * a) / (float)b;
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+// 和 lbph_chisqr_fast 一樣，單位是 pixel 數 (bound 也是)
+inline double lbph_chisqr_fast_u8(const uint8_t *train, const uint8_t *query, int stride, double bound = DBL_MAX)
+{
+    double result = 0.0;
+    const double half_bound = bound * 0.5;
+    for (int j = 0; j < stride; j += 256) {
+        result += lbph_chisqr_block_u8(train + j, query + j, std::min(256, stride - j));
+        if (result > half_bound) return DBL_MAX;
+    }
+    return result * 2;
+}
+
+// L1 距離 (Σ|差|)，全部整數運算：NEON vabd + vpadal，SSE2 psadbw。n 是 16 的倍數而且不超過 256
+inline uint32_t lbph_l1_block_u8(const uint8_t *train, const uint8_t *query, int n)
+{
+#if defined(LBPH_USE_NEON)
+    uint16x8_t acc = vdupq_n_u16(0);    // 每個 lane 最多加 16 次 510，不會溢位
+    for (int j = 0; j < n; j += 16) {
+        acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(train + j), vld1q_u8(query + j)));
+    }
+    uint64x2_t s = vpaddlq_u32(vpaddlq_u16(acc));
+    return (uint32_t)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+#elif defined(LBPH_USE_SSE2) || defined(LBPH_USE_AVX2)
+    __m128i acc = _mm_setzero_si128();
+    for (int j = 0; j < n; j += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(train + j)),
+                                              _mm_loadu_si128((const __m128i *)(query + j))));
+    }
+    return (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#else
+    uint32_t sum = 0;
+    for (int j = 0; j < n; ++j) sum += (uint32_t)std::abs((int)train[j] - (int)query[j]);
+    return sum;
+#endif
+}
+
+// 每 256 個 bin 檢查一次，超過 bound 就回傳 UINT32_MAX (等於 bound 的還會算完，同分時才能照順序選)
+inline uint32_t lbph_l1_u8(const uint8_t *train, const uint8_t *query, int stride, uint32_t bound = UINT32_MAX)
+{
+    uint32_t result = 0;
+    for (int j = 0; j < stride; j += 256) {
+        result += lbph_l1_block_u8(train + j, query + j, std::min(256, stride - j));
+        if (result > bound) return UINT32_MAX;
+    }
+    return result;
+}
+
+enum lbph_metric
+{
+    LBPH_METRIC_CHISQR = 0,     // HISTCMP_CHISQR_ALT，和 OpenCV 相同
+    LBPH_METRIC_L1 = 1,         // 只有 LBPH_U8 模型能用：正規化 histogram 的 L1 距離，尺度和 chi-square 不同
+};
+
+// predict_topk 的一筆結果：label、距離和是第幾個樣本
+struct lbph_match
+{
+    int label;
+    double dist;
+    int index;
+};
+
+// 固定大小的 top-k 收集器 (不配置記憶體，可以放在 stack 上重複用)。
+// 每個 label 只留距離最小的樣本，所以結果是 k 個不同的人，由近到遠；
+// 距離相同時取 index 小的，和 OpenCV 照順序掃、只在更小時才換的結果一樣。
+// k 最多 8 個，插入排好序的陣列比 heap 快
+class lbph_topk
+{
+public:
+    enum { max_k = 8 };
+
+    lbph_topk() : k(1), n(0) {}
+
+    void reset(int capacity)
+    {
+        k = std::max(1, std::min(capacity, (int)max_k));
+        n = 0;
+    }
+
+    int size() const { return n; }
+    int capacity() const { return k; }
+    const lbph_match &operator[](int i) const { return items[i]; }
+
+    // 第 k 名的距離，比它遠的樣本不可能進來 (還沒收滿時是 DBL_MAX)
+    double worst() const { return n == k ? items[n - 1].dist : DBL_MAX; }
+
+    void add(int label, double dist, int index)
+    {
+        lbph_match m = { label, dist, index };
+        int pos = -1;
+        for (int i = 0; i < n; ++i) {
+            if (items[i].label == label) {
+                pos = i;
+                break;
+            }
+        }
+        if (pos >= 0) {
+            if (!better(m, items[pos])) return;
+        } else if (n < k) {
+            pos = n++;
+        } else if (better(m, items[k - 1])) {
+            pos = k - 1;
+        } else {
+            return;
+        }
+        while (pos > 0 && better(m, items[pos - 1])) {
+            items[pos] = items[pos - 1];
+            --pos;
+        }
+        items[pos] = m;
+    }
+
+private:
+    static bool better(const lbph_match &a, const lbph_match &b)
+    {
+        return a.dist < b.dist || (a.dist == b.dist && a.index < b.index);
+    }
+
+    lbph_match items[max_k];
+    int k, n;
+};
+
+// 整個字串都是數字才算 (atoi / atof 遇到 "abc" 會回傳 0，門檻 0 就是全部 Unknown)
+inline bool lbph_parse_int(const std::string &str, int &out)
+{
+    const char *s = str.c_str();
+    char *end = nullptr;
+    errno = 0;
+    long v = std::strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX) return false;
+    out = (int)v;
+    return true;
+}
+
+inline bool lbph_parse_double(const std::string &str, double &out)
+{
+    const char *s = str.c_str();
+    char *end = nullptr;
+    errno = 0;
+    double v = std::strtod(s, &end);
+    if (end == s || *end != '\0' || errno == ERANGE || v != v) return false;
+    out = v;
+    return true;
+}
+
+// open-set 判斷：top-k 裡第一個距離小於自己門檻的人就是答案，都不是就是 Unknown。
+// 門檻可以每個人不同 (照片少、容易被認錯的人設嚴一點)，這時第一名被擋掉還可以是第二名，
+// 所以有個別門檻時 top-k 至少要 2
+struct lbph_open_set
+{
+    double threshold = DBL_MAX;             // 沒有個別設定的人用這個
+    std::map<int, double> class_thresholds;
+
+    double limit(int label) const
+    {
+        auto it = class_thresholds.find(label);
+        return it != class_thresholds.end() ? it->second : threshold;
+    }
+
+    // 回傳答案在 top 裡的位置，-1 = Unknown
+    int decide(const lbph_topk &top) const
+    {
+        for (int i = 0; i < top.size(); ++i) {
+            if (top[i].dist < limit(top[i].label)) return i;
+        }
+        return -1;
+    }
+
+    // "0=75,1=90" → class_thresholds；有一項不是 label=數字 就整個不收，回傳 false
+    bool parse_class_thresholds(const std::string &arg)
+    {
+        std::map<int, double> parsed;
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            size_t eq = item.find('=');
+            int label;
+            double limit;
+            if (eq == std::string::npos || !lbph_parse_int(item.substr(0, eq), label) ||
+                !lbph_parse_double(item.substr(eq + 1), limit)) {
+                return false;
+            }
+            parsed[label] = limit;
+        }
+        if (parsed.empty()) return false;
+        for (const auto &t : parsed) class_thresholds[t.first] = t.second;
+        return true;
+    }
+};
+
+class lbph_engine
+{
+public:
+    lbph_engine() : journal_base(0), journal_stale(false), metric(LBPH_METRIC_CHISQR), coarse_stride(0) {}
+
+    // 模型旁邊有線上註冊的 journal (<model>.enroll) 就一起讀進來；
+    // journal 是註冊在別的模型上的 (model_checksum 不對) 就不讀
+    bool load(const std::string &path)
+    {
+        close();
+        error.clear();
+        if (!model.open(path)) return false;
+        model_path = path;
+        journal_base = model.header().checksum;
+        if (model.header().mapping == LBPH_MAP_UNIFORM) mapping = lbph_uniform_table(model.header().neighbors);
+        coarse_stride = lbph_coarse_stride(model.stride());
+        coarse.assign((size_t)model.count() * coarse_stride, 0.0f);
+        std::vector<float> row;
+        for (int i = 0; i < model.count(); ++i) {
+            lbph_coarsen(row_values(i, row), model.stride(), &coarse[(size_t)i * coarse_stride]);
+        }
+
+        std::vector<int> labels;
+        std::vector<std::string> names;
+        std::vector<float> hist;
+        if (!lbph_journal_read(lbph_journal_path(path), model.dims(), journal_base, labels, names, hist)) {
+            std::cerr << "Warning: " << lbph_journal_path(path) << " was not written for this model, not replayed" << std::endl;
+            journal_stale = true;
+        }
+        for (size_t i = 0; i < labels.size(); ++i) {
+            if (!add_row(&hist[i * model.dims()], labels[i], names[i])) break;
+        }
+        return true;
+    }
+
+    // LBPH_METRIC_L1 只對 LBPH_U8 模型有效，其他模型還是用 chi-square
+    void set_metric(int m) { metric = m; }
+
+    void close()
+    {
+        model.close();
+        model_path.clear();
+        journal_base = 0;
+        journal_stale = false;
+        mapping.clear();
+        coarse.clear();
+        added.clear();
+        added_counts.clear();
+        added_labels.clear();
+        added_names.clear();
+    }
+
+    bool empty() const { return model.empty(); }
+    const std::string &last_error() const { return error.empty() ? model.last_error() : error; }
+    const lbph_model &data() const { return model; }
+    // 樣本數 (模型檔 + 線上註冊的)
+    int count() const { return model.empty() ? 0 : model.count() + (int)added_labels.size(); }
+    int enrolled() const { return (int)added_labels.size(); }
+
+    std::string name_of(int label) const
+    {
+        auto it = added_names.find(label);
+        return it != added_names.end() ? it->second : model.name_of(label);
+    }
+
+    // 模型檔和線上註冊的所有 label → 名字
+    std::map<int, std::string> names() const
+    {
+        std::map<int, std::string> out = model.names();
+        for (const auto &n : added_names) out[n.first] = n.second;
+        return out;
+    }
+
+    // 名字對應的 label，沒有就是 -1
+    int label_of(const std::string &name) const
+    {
+        for (const auto &n : names()) {
+            if (n.second == name) return n.first;
+        }
+        return -1;
+    }
+
+    // 新的人可以用的 label (比所有樣本和名字的 label 都大)
+    int next_label() const
+    {
+        int next = 0;
+        for (int i = 0; i < count(); ++i) next = std::max(next, label_at(i) + 1);
+        for (const auto &n : names()) next = std::max(next, n.first + 1);
+        return next;
+    }
+
+    // 100x100 灰階 (已 equalize) 的臉 → dims 個 float，後面補 0 到 stride
+    void compute_histogram(const cv::Mat &face, std::vector<float> &hist) const
+    {
+        hist.assign(model.stride(), 0.0f);
+        lbph_histogram(face, model.header(), mapping.empty() ? nullptr : &mapping[0], &hist[0]);
+    }
+
+    // 線上註冊 (像 LBPHFaceRecognizer::update)：faces 是和 predict 一樣處理過的臉，
+    // 先 append 到 journal (斷電也不會掉)，再加進記憶體，之後的 predict 就找得到。
+    // 會改到樣本，不能和 predict 同時呼叫
+    bool enroll(const std::vector<cv::Mat> &faces, int label, const std::string &name)
+    {
+        if (model.empty()) {
+            error = "no model loaded";
+            return false;
+        }
+        const int dims = model.dims();
+        std::vector<float> rows(faces.size() * dims), hist;
+        std::vector<uint8_t> counts;
+        for (size_t k = 0; k < faces.size(); ++k) {
+            compute_histogram(faces[k], hist);
+            if (model.dtype() == LBPH_U8 && !to_counts(&hist[0], counts)) {
+                error = "face size does not match the uint8 model";
+                return false;
+            }
+            std::copy(hist.begin(), hist.begin() + dims, rows.begin() + k * dims);
+        }
+        std::string journal = lbph_journal_path(model_path);
+        if (journal_stale) {
+            // 別的模型的 journal 不能接著寫 (之後整份都不會被讀)，改名留著，開一份新的。
+            // 之前留下的 .stale.N 不蓋掉；journal 已經不在 (被手動刪掉、save 刪掉了) 就直接開新的
+            std::string stale;
+            for (int n = 0; stale.empty() || access(stale.c_str(), F_OK) == 0; ++n) {
+                stale = journal + ".stale." + std::to_string(n);
+            }
+            if (std::rename(journal.c_str(), stale.c_str()) == 0) {
+                std::cerr << "Warning: " << journal << " moved to " << stale << std::endl;
+            } else if (errno != ENOENT) {
+                error = "cannot move " + journal + " out of the way";
+                return false;
+            }
+            journal_stale = false;
+        }
+        if (!lbph_journal_append(journal, journal_base, label, name, rows.data(), dims, (int)faces.size())) {
+            error = "cannot write " + journal;
+            return false;
+        }
+        for (size_t k = 0; k < faces.size(); ++k) add_row(&rows[k * dims], label, name);
+        return true;
+    }
+
+    // 模型檔和線上註冊的樣本合併寫成新的模型 (暫存檔 fsync → rename → fsync 資料夾)，
+    // 新模型確定寫到磁碟之後才刪掉 journal，中間斷電時不是舊模型 + journal 就是新模型。
+    // 新模型在、journal 還沒刪 (或熱更新剛好在這時候讀) 也不會重複加樣本：
+    // 新模型的 checksum 不同，舊 journal 不會被 replay。
+    // 已經 mmap 的舊檔案 rename 之後還是有效，這個 engine 不用重新 load，之後的註冊記在新模型名下
+    bool save(const std::string &path)
+    {
+        if (model.empty()) {
+            error = "no model loaded";
+            return false;
+        }
+        const int n = count(), dims = model.dims();
+        std::vector<int> labels(n);
+        std::vector<float> data((size_t)n * dims), row;
+        for (int i = 0; i < n; ++i) {
+            labels[i] = label_at(i);
+            const float *v = row_values(i, row);
+            std::copy(v, v + dims, data.begin() + (size_t)i * dims);
+        }
+        if (!lbph_write_model(path, lbph_params_from_header(model.header()), labels, data.data(), names())) {
+            error = "cannot write " + path;
+            return false;
+        }
+        if (path == model_path) {
+            lbph_model saved;
+            if (!saved.open(path, false)) {
+                error = "cannot reopen " + path + ": " + saved.last_error();
+                return false;
+            }
+            journal_base = saved.header().checksum;
+            journal_stale = false;
+            std::remove(lbph_journal_path(path).c_str());
+        }
+        return true;
+    }
+
+    // 和 LBPHFaceRecognizer::predict 相同：距離 < threshold 裡最小的，沒有就是 -1 / DBL_MAX。
+    // 只讀模型，多個 thread 可以同時呼叫
+    void predict(const cv::Mat &face, int &label, double &dist) const
+    {
+        lbph_topk top;
+        predict_topk(face, 1, top);
+        label = top.size() ? top[0].label : -1;
+        dist = top.size() ? top[0].dist : DBL_MAX;
+    }
+
+    // 距離 < threshold 裡最近的 k 個不同的人 (每個人取最近的樣本)，一次掃過所有樣本
+    void predict_topk(const cv::Mat &face, int k, lbph_topk &top) const
+    {
+        top.reset(k);
+        if (model.empty()) return;
+        std::vector<float> query;
+        compute_histogram(face, query);
+
+        // uint8 模型：臉和訓練時一樣大 (每格 pixel 數相同) 時，query 也換成 pixel 數用整數 kernel 掃
+        const lbph_file_header &h = model.header();
+        std::vector<uint8_t> counts;
+        int cell = ((face.rows - 2 * h.radius) / h.grid_y) * ((face.cols - 2 * h.radius) / h.grid_x);
+        if (model.dtype() == LBPH_U8 && cell == (int)h.cell_pixels) {
+            counts.assign(model.stride(), 0);
+            for (int j = 0; j < model.dims(); ++j) counts[j] = (uint8_t)std::lround(query[j] * cell);
+        }
+        predict_topk_histogram(&query[0], k, top, counts.empty() ? nullptr : &counts[0]);
+    }
+
+    // 已經算好的特徵 (stride 個 float，尾巴補 0) 找最近的樣本。
+    // query_counts 是同一個特徵的 pixel 數 (uint8 模型用，沒有就傳 nullptr)
+    void predict_histogram(const float *query, int &label, double &dist, const uint8_t *query_counts = nullptr) const
+    {
+        lbph_topk top;
+        predict_topk_histogram(query, 1, top, query_counts);
+        label = top.size() ? top[0].label : -1;
+        dist = top.size() ? top[0].dist : DBL_MAX;
+    }
+
+    void predict_topk_histogram(const float *query, int k, lbph_topk &top, const uint8_t *query_counts = nullptr) const
+    {
+        top.reset(k);
+        const int n = count();
+        if (n == 0) return;
+        const bool u8 = model.dtype() == LBPH_U8;
+        if (u8 && query_counts && metric == LBPH_METRIC_L1) {
+            predict_l1(query, query_counts, top);
+            return;
+        }
+        const double cells = u8 ? model.header().cell_pixels : 1.0;
+        const float scale = u8 ? (float)(1.0 / cells) : 1.0f;
+
+        // 粗 histogram 的距離是下界，由小排到大
+        std::vector<float> query_coarse(coarse_stride);
+        lbph_coarsen(query, model.stride(), &query_coarse[0]);
+        std::vector<std::pair<double, int> > order(n);
+        for (int i = 0; i < n; ++i) {
+            order[i].first = lbph_chisqr_fast(&coarse[(size_t)i * coarse_stride], &query_coarse[0], coarse_stride);
+            order[i].second = i;
+        }
+        std::sort(order.begin(), order.end());
+
+        // 依下界的順序用 SIMD 算近似距離；比近似的第 k 名還遠的樣本不可能進 top-k (threshold 以上的也不用)
+        const double threshold = model.header().threshold;
+        const double keep = 1.0 + lbph_rescore_margin;
+        std::vector<double> approx(n, DBL_MAX);
+        lbph_topk approx_top;
+        approx_top.reset(k);
+        for (int j = 0; j < n; ++j) {
+            double bound = std::min(approx_top.worst(), threshold) * keep;
+            if (order[j].first * (1.0 - lbph_rescore_margin) > bound) break;
+            int i = order[j].second;
+            if (!u8) {
+                approx[i] = lbph_chisqr_fast(histogram_at(i), query, model.stride(), bound);
+            } else if (query_counts) {
+                double d = lbph_chisqr_fast_u8(counts_at(i), query_counts, model.stride(), bound * cells);
+                approx[i] = d == DBL_MAX ? DBL_MAX : d / cells;
+            } else {
+                approx[i] = lbph_chisqr_u8(counts_at(i), scale, query, model.dims());
+            }
+            if (approx[i] != DBL_MAX) approx_top.add(label_at(i), approx[i], i);
+        }
+        if (approx_top.size() == 0) return;
+
+        // 可能進 top-k 的樣本用 double 重算，其他樣本的真正距離一定比第 k 名大
+        const double limit = approx_top.worst() * keep;
+        for (int i = 0; i < n; ++i) {
+            if (approx[i] == DBL_MAX || approx[i] > limit) continue;
+            double d = u8 ? lbph_chisqr_u8(counts_at(i), scale, query, model.dims())
+                          : lbph_chisqr(histogram_at(i), query, model.dims());
+            if (d < threshold) top.add(label_at(i), d, i);
+        }
+    }
+
+private:
+    lbph_engine(const lbph_engine &);
+    lbph_engine &operator=(const lbph_engine &);
+
+    // 第 i 個樣本：前面是模型檔 (mmap) 的，後面接線上註冊的
+    int label_at(int i) const
+    {
+        return i < model.count() ? model.label(i) : added_labels[i - model.count()];
+    }
+
+    const float *histogram_at(int i) const
+    {
+        return i < model.count() ? model.histogram(i) : &added[(size_t)(i - model.count()) * model.stride()];
+    }
+
+    const uint8_t *counts_at(int i) const
+    {
+        return i < model.count() ? model.counts(i) : &added_counts[(size_t)(i - model.count()) * model.stride()];
+    }
+
+    // 第 i 個樣本的 float 值 (uint8 模型還原到 row 裡)
+    const float *row_values(int i, std::vector<float> &row) const
+    {
+        if (model.dtype() != LBPH_U8) return histogram_at(i);
+        const float scale = (float)(1.0 / model.header().cell_pixels);
+        const uint8_t *c = counts_at(i);
+        row.resize(model.stride());
+        for (int j = 0; j < model.stride(); ++j) row[j] = (float)c[j] * scale;
+        return &row[0];
+    }
+
+    // 正規化的 histogram → 每格的 pixel 數 (和 lbph_write_model 一樣，要能完全還原才算)
+    bool to_counts(const float *hist, std::vector<uint8_t> &counts) const
+    {
+        const uint32_t cells = model.header().cell_pixels;
+        const float scale = (float)(1.0 / cells);
+        counts.assign(model.stride(), 0);
+        for (int j = 0; j < model.dims(); ++j) {
+            long c = std::lround(hist[j] * cells);
+            if (c < 0 || c > 255 || (float)c * scale != hist[j]) return false;
+            counts[j] = (uint8_t)c;
+        }
+        return true;
+    }
+
+    // dims 個 float 的樣本加到記憶體 (後面補 0 到 stride)，粗 histogram 也一起算
+    bool add_row(const float *hist, int label, const std::string &name)
+    {
+        const int stride = model.stride();
+        std::vector<float> row(hist, hist + model.dims());
+        row.resize(stride, 0.0f);
+        if (model.dtype() == LBPH_U8) {
+            std::vector<uint8_t> counts;
+            if (!to_counts(&row[0], counts)) return false;
+            added_counts.insert(added_counts.end(), counts.begin(), counts.end());
+        } else {
+            added.insert(added.end(), row.begin(), row.end());
+        }
+        added_labels.push_back(label);
+        if (!name.empty()) added_names[label] = name;
+        coarse.resize(coarse.size() + coarse_stride, 0.0f);
+        lbph_coarsen(&row[0], stride, &coarse[coarse.size() - coarse_stride]);
+        return true;
+    }
+
+    // L1：粗 histogram 的 L1 也是下界 (三角不等式)，整數距離不用重算，同分時取前面的樣本
+    void predict_l1(const float *query, const uint8_t *query_counts, lbph_topk &top) const
+    {
+        const int n = count();
+        const double cells = model.header().cell_pixels;
+        std::vector<float> query_coarse(coarse_stride);
+        lbph_coarsen(query, model.stride(), &query_coarse[0]);
+        std::vector<std::pair<double, int> > order(n);
+        for (int i = 0; i < n; ++i) {
+            const float *c = &coarse[(size_t)i * coarse_stride];
+            double lb = 0.0;
+            for (int g = 0; g < coarse_stride; ++g) lb += std::fabs((double)c[g] - query_coarse[g]);
+            order[i].first = lb * cells;
+            order[i].second = i;
+        }
+        std::sort(order.begin(), order.end());
+
+        const double threshold = model.header().threshold * cells;
+        for (int j = 0; j < n; ++j) {
+            // top 裡存的是 pixel 數 / cells，換回整數的 pixel 數當 bound
+            double worst = top.worst() == DBL_MAX ? DBL_MAX : std::ceil(top.worst() * cells);
+            if (order[j].first * (1.0 - lbph_rescore_margin) > std::min(worst, threshold)) break;
+            int i = order[j].second;
+            uint32_t d = lbph_l1_u8(counts_at(i), query_counts, model.stride(),
+                                    worst < UINT32_MAX ? (uint32_t)worst : UINT32_MAX);
+            if (d == UINT32_MAX || d >= threshold) continue;
+            top.add(label_at(i), d / cells, i);
+        }
+    }
+
+    lbph_model model;
+    std::string model_path;
+    uint32_t journal_base;      // journal 要記的模型 checksum
+    bool journal_stale;         // 模型旁邊的 journal 是別的模型的
+    std::string error;
+    int metric;
+    std::vector<int> mapping;   // uniform 模型的 code → bin，full 模型是空的
+    std::vector<float> coarse;  // 每個樣本的粗 histogram (count x coarse_stride)
+    int coarse_stride;
+    // 線上註冊的樣本，每列 stride 個 (float 模型放 added，uint8 模型放 added_counts)
+    std::vector<float> added;
+    std::vector<uint8_t> added_counts;
+    std::vector<int> added_labels;
+    std::map<int, std::string> added_names;
+};
+
+#endif // LBPH_ENGINE_H
@@ -0,0 +1,479 @@
+#ifndef LBPH_MODEL_H
+#define LBPH_MODEL_H
+
+// LBPH 模型的二進位格式
+// OpenCV 存的 YAML 把每個 16384 維的 histogram 印成文字，板子上開機讀一次要好幾秒。
+// 這個格式 mmap 之後直接拿指標用，不用 parse：
+//
+//   [header 96 bytes]
+//   [labels       int32 x count]            每個訓練樣本的 label
+//   [classes      lbph_class_entry x class_count]  label → 名字
+//   [padding 到 64 bytes 對齊]
+//   [histograms   count 列，每列 stride 個元素，多出來的補 0]
+//
+// histogram 可以存成 float (和 OpenCV 一樣) 或 uint8 (每格的 pixel 數，大小只有 1/4)。
+// 每格最多 cell_pixels 個 pixel (100x100 的臉是 12x12 = 144)，uint8 放得下，
+// 而 OpenCV 的 float 值就是 (float)count * (float)(1.0 / cell_pixels)，可以完全還原，沒有損失。
+//
+// header 之後的所有 byte 算一個 CRC32 存在 header 裡，讀的時候檢查。
+// 數字都是 little-endian (ARM 和 x86 都是)。
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char lbph_magic[8] = { 'L', 'B', 'P', 'H', 'B', 'I', 'N', '\0' };
+const uint32_t lbph_format_version = 1;
+
+enum lbph_dtype
+{
+    LBPH_F32 = 0,       // OpenCV 原本的正規化 float histogram
+    LBPH_U8 = 1,        // 每個 bin 的 pixel 數
+};
+
+inline size_t lbph_dtype_size(uint32_t dtype) { return dtype == LBPH_U8 ? 1 : sizeof(float); }
+
+enum lbph_mapping
+{
+    LBPH_MAP_FULL = 0,      // 每個 code 一個 bin (2^neighbors 個)，和 OpenCV 相同
+    LBPH_MAP_UNIFORM = 1,   // uniform pattern 各一個 bin，其他全部放最後一個 bin
+};
+
+struct lbph_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t radius;
+    int32_t neighbors;
+    int32_t grid_x;
+    int32_t grid_y;
+    uint32_t bins;              // 每格的 bin 數
+    uint32_t dims;              // grid_x * grid_y * bins
+    uint32_t stride;            // 每列佔幾個元素 (補到 16 的倍數，SIMD 讀取不用處理尾巴)
+    uint32_t dtype;             // lbph_dtype
+    uint32_t count;             // 訓練樣本數
+    uint32_t class_count;
+    uint32_t labels_offset;     // 以下都是從檔案開頭算的 byte offset
+    uint32_t classes_offset;
+    uint32_t hist_offset;
+    uint32_t file_size;
+    double threshold;           // OpenCV 模型的 threshold，預設 DBL_MAX
+    uint32_t checksum;          // header 之後所有 byte 的 CRC32
+    uint32_t mapping;           // lbph_mapping (舊檔案這裡是 0 = FULL)
+    uint32_t cell_pixels;       // 每格的 pixel 數 (LBPH_U8 用來還原成 float)
+    uint32_t reserved[1];
+};
+static_assert(sizeof(lbph_file_header) == 96, "lbph_file_header layout");
+
+struct lbph_class_entry
+{
+    int32_t label;
+    char name[60];
+};
+static_assert(sizeof(lbph_class_entry) == 64, "lbph_class_entry layout");
+
+// 訓練參數 (和 cv::face::LBPHFaceRecognizer 的參數一樣)
+struct lbph_params
+{
+    int radius = 1;
+    int neighbors = 8;
+    int grid_x = 8;
+    int grid_y = 8;
+    double threshold = 1.7976931348623157e+308;
+    bool uniform = false;       // true: 每格 59 個 bin (neighbors = 8 時) 的 uniform LBP
+    int dtype = LBPH_F32;       // LBPH_U8 時 histogram 存成 pixel 數
+    int cell_pixels = 144;      // LBPH_U8 用：訓練臉每格的 pixel 數
+};
+
+// 已經存好的模型的參數 (重新寫一份模型用)
+inline lbph_params lbph_params_from_header(const lbph_file_header &h)
+{
+    lbph_params params;
+    params.radius = h.radius;
+    params.neighbors = h.neighbors;
+    params.grid_x = h.grid_x;
+    params.grid_y = h.grid_y;
+    params.threshold = h.threshold;
+    params.uniform = h.mapping == LBPH_MAP_UNIFORM;
+    params.dtype = h.dtype;
+    if (h.dtype == LBPH_U8) params.cell_pixels = h.cell_pixels;
+    return params;
+}
+
+// zlib 的 CRC32
+inline uint32_t lbph_crc32(const void *data, size_t len, uint32_t crc = 0)
+{
+    struct crc_table
+    {
+        uint32_t v[256];
+        crc_table()
+        {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                v[i] = c;
+            }
+        }
+    };
+    static const crc_table t;       // C++11 之後 static 區域變數的初始化是 thread-safe 的
+    const uint32_t *table = t.v;
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline size_t lbph_align(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+// 每格的 bin 數：full 是 2^P，uniform 是 P(P-1)+2 種 uniform pattern 再加一個「其他」
+inline int lbph_bin_count(int neighbors, bool uniform)
+{
+    return uniform ? neighbors * (neighbors - 1) + 3 : 1 << neighbors;
+}
+
+// path 所在的資料夾 fsync 一次，rename / 新增的目錄項目才會真的寫到磁碟
+inline bool lbph_sync_dir(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    if (dir.empty()) dir = "/";
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    // FAT 之類的檔案系統不支援對資料夾 fsync (EINVAL)，那裡 rename 本來就沒辦法再保證更多
+    bool ok = fsync(fd) == 0 || errno == EINVAL;
+    ::close(fd);
+    return ok;
+}
+
+// histograms: count 列 x dims 的 float (每列連續)。
+// LBPH_U8 時每個值換回 pixel 數，換不回原本的 float (不是 cell_pixels 的正規化 histogram) 就失敗
+inline bool lbph_write_model(const std::string &path, const lbph_params &params,
+                             const std::vector<int> &labels, const float *histograms,
+                             const std::map<int, std::string> &names)
+{
+    lbph_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, lbph_magic, sizeof(h.magic));
+    h.version = lbph_format_version;
+    h.header_size = sizeof(h);
+    h.radius = params.radius;
+    h.neighbors = params.neighbors;
+    h.grid_x = params.grid_x;
+    h.grid_y = params.grid_y;
+    h.bins = lbph_bin_count(params.neighbors, params.uniform);
+    h.dims = params.grid_x * params.grid_y * h.bins;
+    h.stride = (uint32_t)lbph_align(h.dims, 16);
+    h.dtype = params.dtype;
+    h.cell_pixels = params.dtype == LBPH_U8 ? params.cell_pixels : 0;
+    h.mapping = params.uniform ? LBPH_MAP_UNIFORM : LBPH_MAP_FULL;
+    h.count = (uint32_t)labels.size();
+    h.class_count = (uint32_t)names.size();
+    h.threshold = params.threshold;
+    h.labels_offset = sizeof(h);
+    h.classes_offset = h.labels_offset + h.count * sizeof(int32_t);
+    h.hist_offset = (uint32_t)lbph_align(h.classes_offset + h.class_count * sizeof(lbph_class_entry), 64);
+    const size_t elem = lbph_dtype_size(h.dtype);
+    h.file_size = h.hist_offset + h.count * h.stride * elem;
+
+    // body 是 header 之後的部分，offset 要扣掉 header 大小
+    std::vector<uint8_t> body(h.file_size - sizeof(h), 0);
+    const size_t labels_at = h.labels_offset - sizeof(h);
+    const size_t classes_at = h.classes_offset - sizeof(h);
+    const size_t hist_at = h.hist_offset - sizeof(h);
+    for (uint32_t i = 0; i < h.count; ++i) {
+        int32_t l = labels[i];
+        std::memcpy(&body[labels_at + i * sizeof(int32_t)], &l, sizeof(l));
+    }
+    uint32_t c = 0;
+    for (const auto &n : names) {
+        lbph_class_entry e;
+        std::memset(&e, 0, sizeof(e));
+        e.label = n.first;
+        std::strncpy(e.name, n.second.c_str(), sizeof(e.name) - 1);
+        std::memcpy(&body[classes_at + c * sizeof(e)], &e, sizeof(e));
+        c++;
+    }
+    for (uint32_t i = 0; i < h.count; ++i) {
+        const float *src = histograms + (size_t)i * h.dims;
+        uint8_t *dst = &body[hist_at + (size_t)i * h.stride * elem];
+        if (h.dtype == LBPH_U8) {
+            const float scale = (float)(1.0 / h.cell_pixels);
+            for (uint32_t j = 0; j < h.dims; ++j) {
+                long count = std::lround(src[j] * h.cell_pixels);
+                if (count < 0 || count > 255 || (float)count * scale != src[j]) return false;
+                dst[j] = (uint8_t)count;
+            }
+        } else {
+            std::memcpy(dst, src, h.dims * sizeof(float));
+        }
+    }
+    h.checksum = lbph_crc32(&body[0], body.size());
+
+    // 先寫到暫存檔再 rename，讀的人不會看到寫一半的檔案。
+    // 暫存檔 fsync 之後才 rename、rename 之後再 fsync 資料夾，回傳 true 時新模型一定已經在磁碟上
+    // (SD 卡、隨身碟斷電時不會留下空的或寫一半的模型)
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+              (body.empty() || std::fwrite(&body[0], body.size(), 1, f) == 1);
+    ok = std::fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return lbph_sync_dir(path);
+}
+
+// 檔案開頭是不是二進位模型
+inline bool lbph_is_binary_model(const std::string &path)
+{
+    char magic[8] = {};
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    size_t n = std::fread(magic, 1, sizeof(magic), f);
+    std::fclose(f);
+    return n == sizeof(magic) && std::memcmp(magic, lbph_magic, sizeof(magic)) == 0;
+}
+
+// 線上註冊的 journal：模型檔旁邊的 <model>.enroll，每註冊一個樣本 append 一筆，不用重寫整個模型。
+// 每筆是 [lbph_journal_record][dims 個 float]，checksum 蓋 model_checksum、label、name 和 histogram。
+// model_checksum 是註冊時模型 header 的 checksum：重新訓練、轉檔、壓縮過的模型 dims 一樣但 checksum 不同，
+// 不會把舊的 journal 接到別的模型上 (label 可能撞到新模型的人)。
+// 最後一筆寫到一半 (斷電) 時 header 或 checksum 對不上，讀到那裡為止。
+const char lbph_journal_magic[4] = { 'L', 'B', 'P', 'J' };
+
+struct lbph_journal_record
+{
+    char magic[4];
+    uint32_t dims;
+    int32_t label;
+    uint32_t checksum;
+    char name[60];
+    uint32_t model_checksum;    // 註冊時模型 header 的 checksum
+};
+static_assert(sizeof(lbph_journal_record) == 80, "lbph_journal_record layout");
+
+inline std::string lbph_journal_path(const std::string &model_path) { return model_path + ".enroll"; }
+
+inline uint32_t lbph_journal_checksum(const lbph_journal_record &r, const float *hist)
+{
+    uint32_t crc = lbph_crc32(&r.model_checksum, sizeof(r.model_checksum));
+    crc = lbph_crc32(&r.label, sizeof(r.label), crc);
+    crc = lbph_crc32(r.name, sizeof(r.name), crc);
+    return lbph_crc32(hist, r.dims * sizeof(float), crc);
+}
+
+// count 筆同一個 label 的 histogram (每筆 dims 個 float，連續放) 接在 journal 後面，寫完 fsync 一次
+inline bool lbph_journal_append(const std::string &path, uint32_t model_checksum, int label, const std::string &name,
+                                const float *histograms, int dims, int count)
+{
+    FILE *f = std::fopen(path.c_str(), "ab");
+    if (!f) return false;
+    bool ok = true;
+    for (int i = 0; i < count && ok; ++i) {
+        const float *hist = histograms + (size_t)i * dims;
+        lbph_journal_record r;
+        std::memset(&r, 0, sizeof(r));
+        std::memcpy(r.magic, lbph_journal_magic, sizeof(r.magic));
+        r.dims = (uint32_t)dims;
+        r.label = label;
+        r.model_checksum = model_checksum;
+        std::strncpy(r.name, name.c_str(), sizeof(r.name) - 1);
+        r.checksum = lbph_journal_checksum(r, hist);
+        ok = std::fwrite(&r, sizeof(r), 1, f) == 1 && std::fwrite(hist, sizeof(float), dims, f) == (size_t)dims;
+    }
+    ok = std::fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = (std::fclose(f) == 0) && ok;
+    return ok && lbph_sync_dir(path);     // 第一次 append 時 journal 是新建的檔案
+}
+
+// 讀出 journal 裡所有完整的紀錄 (histograms 每筆 dims 個 float)，沒有 journal 就是 0 筆。
+// 是不是這個模型的 journal 只看第一筆：第一筆的 magic、dims 或 model_checksum 不對就一筆都不讀、
+// 不動它，回傳 false。之後的紀錄不管是 header 還是 checksum 壞掉，都當成寫到一半 (斷電) 的尾巴：
+// 讀到那裡為止並切掉，之後 append 的紀錄才接得上。
+inline bool lbph_journal_read(const std::string &path, int dims, uint32_t model_checksum, std::vector<int> &labels,
+                              std::vector<std::string> &names, std::vector<float> &histograms)
+{
+    labels.clear();
+    names.clear();
+    histograms.clear();
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return true;
+    std::vector<float> hist(dims);
+    long valid = 0;
+    bool ok = true;
+    lbph_journal_record r;
+    while (std::fread(&r, sizeof(r), 1, f) == 1) {
+        if (std::memcmp(r.magic, lbph_journal_magic, sizeof(r.magic)) != 0 || r.dims != (uint32_t)dims ||
+            r.model_checksum != model_checksum) {
+            if (valid == 0) ok = false;
+            break;
+        }
+        if (std::fread(&hist[0], sizeof(float), dims, f) != (size_t)dims ||
+            lbph_journal_checksum(r, &hist[0]) != r.checksum) {
+            break;
+        }
+        labels.push_back(r.label);
+        names.push_back(std::string(r.name, strnlen(r.name, sizeof(r.name))));
+        histograms.insert(histograms.end(), hist.begin(), hist.end());
+        valid = std::ftell(f);
+    }
+    bool trailing = ok && std::fseek(f, 0, SEEK_END) == 0 && std::ftell(f) > valid;
+    std::fclose(f);
+    if (trailing && truncate(path.c_str(), valid) != 0) return false;
+    return ok;
+}
+
+// 唯讀 mmap 的模型
+class lbph_model
+{
+public:
+    lbph_model() : map(nullptr), map_size(0), hdr(nullptr) {}
+    ~lbph_model() { close(); }
+
+    bool open(const std::string &path, bool verify = true)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(lbph_file_header)) {
+            ::close(fd);
+            error = path + " is too small";
+            return false;
+        }
+        map_size = (size_t)st.st_size;
+        map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            error = "mmap failed for " + path;
+            return false;
+        }
+        if (!validate(verify)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (map) munmap(map, map_size);
+        map = nullptr;
+        map_size = 0;
+        hdr = nullptr;
+    }
+
+    bool empty() const { return hdr == nullptr; }
+    const std::string &last_error() const { return error; }
+
+    const lbph_file_header &header() const { return *hdr; }
+    int count() const { return (int)hdr->count; }
+    int dims() const { return (int)hdr->dims; }
+    int stride() const { return (int)hdr->stride; }
+    int bins() const { return (int)hdr->bins; }
+    uint32_t dtype() const { return hdr->dtype; }
+
+    int label(int i) const
+    {
+        int32_t l;
+        std::memcpy(&l, bytes() + hdr->labels_offset + i * sizeof(int32_t), sizeof(l));
+        return l;
+    }
+
+    // LBPH_F32 的第 i 列
+    const float *histogram(int i) const
+    {
+        return (const float *)(bytes() + hdr->hist_offset) + (size_t)i * hdr->stride;
+    }
+
+    // LBPH_U8 的第 i 列
+    const uint8_t *counts(int i) const
+    {
+        return bytes() + hdr->hist_offset + (size_t)i * hdr->stride;
+    }
+
+    // label 的名字，沒有就回傳空字串
+    std::string name_of(int label) const
+    {
+        for (uint32_t c = 0; c < hdr->class_count; ++c) {
+            const lbph_class_entry *e = (const lbph_class_entry *)(bytes() + hdr->classes_offset) + c;
+            if (e->label == label) return std::string(e->name, strnlen(e->name, sizeof(e->name)));
+        }
+        return std::string();
+    }
+
+    // 所有 label → 名字
+    std::map<int, std::string> names() const
+    {
+        std::map<int, std::string> out;
+        for (uint32_t c = 0; c < hdr->class_count; ++c) {
+            const lbph_class_entry *e = (const lbph_class_entry *)(bytes() + hdr->classes_offset) + c;
+            out[e->label] = std::string(e->name, strnlen(e->name, sizeof(e->name)));
+        }
+        return out;
+    }
+
+private:
+    lbph_model(const lbph_model &);
+    lbph_model &operator=(const lbph_model &);
+
+    const uint8_t *bytes() const { return (const uint8_t *)map; }
+
+    bool validate(bool verify)
+    {
+        const lbph_file_header *h = (const lbph_file_header *)map;
+        if (std::memcmp(h->magic, lbph_magic, sizeof(h->magic)) != 0) {
+            error = "not a binary LBPH model";
+            return false;
+        }
+        if (h->version != lbph_format_version || h->header_size != sizeof(lbph_file_header)) {
+            error = "unsupported model version " + std::to_string(h->version);
+            return false;
+        }
+        if (h->file_size != map_size || h->dtype > LBPH_U8 || h->mapping > LBPH_MAP_UNIFORM ||
+            (h->dtype == LBPH_U8 && (h->cell_pixels < 1 || h->cell_pixels > 255)) ||
+            h->neighbors < 1 || h->neighbors > 16 || h->radius < 1 || h->grid_x < 1 || h->grid_y < 1 ||
+            h->bins != (uint32_t)lbph_bin_count(h->neighbors, h->mapping == LBPH_MAP_UNIFORM) ||
+            h->dims != (uint32_t)(h->grid_x * h->grid_y) * h->bins || h->stride < h->dims ||
+            h->hist_offset % 64 != 0 ||
+            h->labels_offset + (uint64_t)h->count * sizeof(int32_t) > h->classes_offset ||
+            h->classes_offset + (uint64_t)h->class_count * sizeof(lbph_class_entry) > h->hist_offset ||
+            h->hist_offset + (uint64_t)h->count * h->stride * lbph_dtype_size(h->dtype) > map_size) {
+            error = "corrupt model header";
+            return false;
+        }
+        if (verify && lbph_crc32(bytes() + sizeof(lbph_file_header), map_size - sizeof(lbph_file_header)) != h->checksum) {
+            error = "model checksum mismatch";
+            return false;
+        }
+        hdr = h;
+        return true;
+    }
+
+    void *map;
+    size_t map_size;
+    const lbph_file_header *hdr;
+    std::string error;
+};
+
+#endif // LBPH_MODEL_H
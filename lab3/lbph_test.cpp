@@ -1,7 +1,19 @@
+// 用法：
+//   ./lbph_test [model ...] [--unknown-threshold 80] [--class-threshold label=D,...]
+// 可以一次給好幾個模型 (OpenCV 的 YAML 或 lbph_train --binary / --uniform / --u8 的二進位模型)，
+// 每張偵測到的臉都丟給每個模型 predict，最後印出各模型的正確率和平均 predict 時間。
+// uint8 模型的路徑後面加 ":l1" 改用整數 L1 距離，例如 lbph_model_class_u8.bin:l1
+// 正確率有兩種：最近的人是不是對的 (closed-set)，和套上 Unknown 門檻之後 (open-set，
+// 不在 label_names 裡的人答 Unknown 才算對)。
+// 結果圖只畫第一個模型的結果。
 #include <opencv2/opencv.hpp>
 #include <opencv2/face.hpp>
+#include <chrono>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+
+#include "lbph_engine.h"
 
 namespace fs = std::filesystem;
 using namespace cv;
@@ -12,7 +24,59 @@ map<int, string> label_names = {
     {1, "Wilson"},
 };
 
-int main(){
+// 要評估的模型：YAML 交給 OpenCV，二進位模型用 lbph_engine
+struct model_under_test
+{
+    string path;
+    Ptr<LBPHFaceRecognizer> recognizer;
+    lbph_engine engine;
+    int dims = 0;
+    int total = 0;
+    int correct = 0;
+    int open_correct = 0;
+    double predict_ms = 0.0;
+
+    bool load(const string &model_path)
+    {
+        path = model_path;
+        string file = path;
+        bool l1 = path.size() > 3 && path.compare(path.size() - 3, 3, ":l1") == 0;
+        if (l1) file = path.substr(0, path.size() - 3);
+        if (lbph_is_binary_model(file)) {
+            if (!engine.load(file)) return false;
+            if (l1 && engine.data().dtype() != LBPH_U8) return false;
+            engine.set_metric(l1 ? LBPH_METRIC_L1 : LBPH_METRIC_CHISQR);
+            dims = engine.data().dims();
+            return true;
+        }
+        try {
+            recognizer = Algorithm::load<LBPHFaceRecognizer>(file);
+        } catch (...) {
+            return false;
+        }
+        if (!recognizer || recognizer->empty()) return false;
+        dims = (int)recognizer->getHistograms()[0].total();
+        return true;
+    }
+
+    // 最近的 k 個不同的人
+    void predict(const Mat &face, int k, lbph_topk &top)
+    {
+        auto t0 = chrono::steady_clock::now();
+        if (!engine.empty()) {
+            engine.predict_topk(face, k, top);
+        } else {
+            Ptr<StandardCollector> collector = StandardCollector::create(recognizer->getThreshold());
+            recognizer->predict(face, collector);
+            vector<pair<int, double>> results = collector->getResults(false);
+            top.reset(k);
+            for (size_t i = 0; i < results.size(); ++i) top.add(results[i].first, results[i].second, (int)i);
+        }
+        predict_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    }
+};
+
+int main(int argc, char *argv[]){
     string test_path = "../data";
     string face_cascade_path = "/home/wilsonw/opencv/opencv-4.x/data/haarcascades/haarcascade_frontalface_default.xml";
     string lbph_model_path = "../../lbph_train/lbph_model.yml";
@@ -23,23 +87,56 @@ int main(){
         cerr << "Error: Cannot load Haar cascade classifier." << endl;
     }
 
-    Ptr<LBPHFaceRecognizer> lbph_model = Algorithm::load<LBPHFaceRecognizer>(lbph_model_path);
-    if(lbph_model->empty()){
-        cerr << "Error: Cannot load LBPH model." << endl;
+    vector<string> model_paths;
+    lbph_open_set open_set;
+    open_set.threshold = 80.0;
+    int top_k = 1;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--unknown-threshold" && i + 1 < argc) {
+            if (!lbph_parse_double(argv[++i], open_set.threshold)) {
+                cerr << "Error: Bad --unknown-threshold value: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--class-threshold" && i + 1 < argc) {
+            if (!open_set.parse_class_thresholds(argv[++i])) {
+                cerr << "Error: Bad --class-threshold value: " << argv[i] << endl;
+                return 1;
+            }
+        } else {
+            model_paths.push_back(arg);
+        }
     }
+    if (!open_set.class_thresholds.empty()) top_k = 2;     // 第一名被自己的門檻擋掉時還可以是第二名
+    if (model_paths.empty()) model_paths.push_back(lbph_model_path);
+
+    vector<unique_ptr<model_under_test>> models;
+    for (const auto &path : model_paths) {
+        unique_ptr<model_under_test> m(new model_under_test());
+        if (!m->load(path)) {
+            cerr << "Error: Cannot load LBPH model " << path << endl;
+            continue;
+        }
+        models.push_back(move(m));
+    }
+    if (models.empty()) return 1;
 
     if (fs::exists(result_name)){
         fs::remove_all(result_name);
     }
-    else{
-        fs::create_directory(result_name);
-    }
+    fs::create_directory(result_name);
 
     for (const auto& person_dir : fs::directory_iterator(test_path)) {
         if (!person_dir.is_directory()) continue;
         string person = person_dir.path().filename().string();
         cout << "Processing person: " << person << endl;
 
+        // 資料夾名稱就是正確答案
+        int truth = -1;
+        for (const auto &n : label_names) {
+            if (n.second == person) truth = n.first;
+        }
+
         int idx = 0;
         for (const auto& img_file : fs::directory_iterator(person_dir.path())) {
             Mat img = imread(img_file.path().string());
@@ -59,10 +156,25 @@ int main(){
                 double confidence = 0.0;
 
                 equalizeHist(face_img, face_img);
-                lbph_model->predict(face_img, predicted_label, confidence);
+                // 和訓練、lab3-1 一樣縮成 100x100 (uint8 模型的整數 kernel 也要每格 pixel 數相同)
+                resize(face_img, face_img, Size(100, 100));
+                for (size_t m = 0; m < models.size(); ++m) {
+                    lbph_topk top;
+                    models[m]->predict(face_img, top_k, top);
+                    int pick = open_set.decide(top);
+                    int label = pick >= 0 ? top[pick].label : -1;
+                    models[m]->total++;
+                    int nearest = top.size() ? top[0].label : -1;
+                    if (nearest == truth) models[m]->correct++;
+                    if (label == truth) models[m]->open_correct++;
+                    if (m == 0) {
+                        predicted_label = label;
+                        confidence = pick >= 0 ? top[pick].dist : 0.0;
+                    }
+                }
 
                 string text;
-                if(predicted_label >= 0 && confidence < 80.0){
+                if (predicted_label >= 0) {
                     text = label_names[predicted_label] + " (" + cv::format("%.1f", confidence) + ")";
                 }
                 else{
@@ -79,6 +191,17 @@ int main(){
         }
     }
 
+    // closed-set 只看最近的樣本是不是同一個人；open-set 套上 Unknown 的門檻
+    // (uniform 模型和 L1 的距離尺度不一樣，門檻要各自調)
+    cout << endl << "model, dims, faces, accuracy, open-set accuracy, avg predict ms" << endl;
+    for (const auto &m : models) {
+        double accuracy = m->total ? 100.0 * m->correct / m->total : 0.0;
+        double open_accuracy = m->total ? 100.0 * m->open_correct / m->total : 0.0;
+        double avg_ms = m->total ? m->predict_ms / m->total : 0.0;
+        cout << m->path << ", " << m->dims << ", " << m->total << ", " << cv::format("%.2f%%", accuracy) << ", "
+             << cv::format("%.2f%%", open_accuracy) << ", " << cv::format("%.3f", avg_ms) << endl;
+    }
+
     // int correct_predictions = 0;
 
     // for (size_t i = 0; i < face_list.size(); i++) {
@@ -1,75 +1,138 @@
-#include <opencv2/opencv.hpp>
-#include <opencv2/face.hpp>
-#include <iostream>
-#include <filesystem>
-
-namespace fs = std::filesystem;
-using namespace cv;
-using namespace std;
-
-// 標籤對應
-std::map<std::string, int> label_names = {
-    {"Shark", 0},
-    {"Wilson", 1},
-};
-
-string train_path = "./data";
-string face_cascade_path = "./haarcascades/haarcascade_frontalface_default.xml";
-string face_img_path = "./face";
-string model_name = "lbph_model_class.yml";
-
-int main() {
-    vector<Mat> face_list;
-    vector<int> class_list;
-
-    CascadeClassifier face_cascade;
-    if (!face_cascade.load(face_cascade_path)) {
-        cerr << "Error: Cannot load Haar cascade classifier." << std::endl;
-    }
-
-    if (fs::exists(face_img_path)){
-        fs::remove_all(face_img_path);
-    }
-    fs::create_directory(face_img_path);
-
-    for (const auto& person_dir : fs::directory_iterator(train_path)) {
-        if (!person_dir.is_directory()) continue;
-        string person = person_dir.path().filename().string();
-        cout << "Processing person: " << person << endl;
-
-        int idx = label_names[person];
-
-        for (const auto& img_file : fs::directory_iterator(person_dir.path())) {
-            Mat img = imread(img_file.path().string(), IMREAD_GRAYSCALE);
-            if (img.empty()) continue;
-
-            vector<Rect> detected_faces;
-            face_cascade.detectMultiScale(img, detected_faces, 1.2, 5);
-
-            if (detected_faces.empty()) continue;
-
-            int num = 0;
-            for (const auto& face_rect : detected_faces) {
-                // if (face_rect.width < 100)  continue;
-
-                Mat face_img = img(face_rect).clone();
-                equalizeHist(face_img, face_img);
-                resize(face_img, face_img, Size(100, 100));
-                face_list.push_back(face_img);
-                class_list.push_back(idx);
-                imwrite(face_img_path + "/" + person + "_" + img_file.path().stem().string() + "_" + to_string(num) + ".jpg", face_img);
-                num++;
-            }
-        }
-    }
-
-    // 建立 LBPH 臉部辨識器
-    Ptr<face::LBPHFaceRecognizer> face_recognizer = face::LBPHFaceRecognizer::create();
-    face_recognizer->train(face_list, class_list);
-
-    // 儲存模型
-    face_recognizer->save("./" + model_name);
-    cout << "Training complete. Model saved to " << model_name << endl;
-
-    return 0;
+// 用法：
+//   ./lbph_train              OpenCV LBPHFaceRecognizer，存成 YAML
+//   ./lbph_train --binary     同樣的 256 bin 特徵，直接存成 lbph_model.h 的二進位格式
+//   ./lbph_train --uniform    uniform LBP (每格 59 bin，特徵 16384 → 3776 維)，存成二進位格式
+//   加上 --u8                 histogram 存成每格的 pixel 數 (uint8，模型小 4 倍，predict 結果不變)
+#include <opencv2/opencv.hpp>
+#include <opencv2/face.hpp>
+#include <iostream>
+#include <filesystem>
+
+#include "lbph_engine.h"
+
+namespace fs = std::filesystem;
+using namespace cv;
+using namespace std;
+
+// 標籤對應
+std::map<std::string, int> label_names = {
+    {"Shark", 0},
+    {"Wilson", 1},
+};
+
+string train_path = "./data";
+string face_cascade_path = "./haarcascades/haarcascade_frontalface_default.xml";
+string face_img_path = "./face";
+string model_name = "lbph_model_class.yml";
+
+// face_list 的 LBPH 特徵自己算，存成二進位模型 (OpenCV 的 LBPH 不支援 uniform pattern)
+bool save_binary(const vector<Mat> &face_list, const vector<int> &class_list, bool uniform, bool u8, const string &path)
+{
+    lbph_params params;
+    params.uniform = uniform;
+    if (u8 && !face_list.empty()) {
+        params.dtype = LBPH_U8;
+        int r = params.radius;
+        params.cell_pixels = ((face_list[0].rows - 2 * r) / params.grid_y) * ((face_list[0].cols - 2 * r) / params.grid_x);
+    }
+    lbph_file_header h;
+    memset(&h, 0, sizeof(h));
+    h.radius = params.radius;
+    h.neighbors = params.neighbors;
+    h.grid_x = params.grid_x;
+    h.grid_y = params.grid_y;
+    h.bins = lbph_bin_count(params.neighbors, uniform);
+    h.dims = h.grid_x * h.grid_y * h.bins;
+
+    vector<int> mapping;
+    if (uniform) mapping = lbph_uniform_table(params.neighbors);
+    vector<float> data((size_t)h.dims * face_list.size());
+    for (size_t i = 0; i < face_list.size(); ++i) {
+        lbph_histogram(face_list[i], h, uniform ? mapping.data() : nullptr, &data[i * h.dims]);
+    }
+
+    map<int, string> names;
+    for (const auto &n : label_names) names[n.second] = n.first;
+    return lbph_write_model(path, params, class_list, data.data(), names);
+}
+
+int main(int argc, char *argv[]) {
+    bool binary = false, uniform = false, u8 = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--binary") {
+            binary = true;
+        } else if (arg == "--uniform") {
+            binary = uniform = true;
+        } else if (arg == "--u8") {
+            binary = u8 = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--binary | --uniform] [--u8]" << endl;
+            return 1;
+        }
+    }
+
+    vector<Mat> face_list;
+    vector<int> class_list;
+
+    CascadeClassifier face_cascade;
+    if (!face_cascade.load(face_cascade_path)) {
+        cerr << "Error: Cannot load Haar cascade classifier." << std::endl;
+    }
+
+    if (fs::exists(face_img_path)){
+        fs::remove_all(face_img_path);
+    }
+    fs::create_directory(face_img_path);
+
+    for (const auto& person_dir : fs::directory_iterator(train_path)) {
+        if (!person_dir.is_directory()) continue;
+        string person = person_dir.path().filename().string();
+        cout << "Processing person: " << person << endl;
+
+        int idx = label_names[person];
+
+        for (const auto& img_file : fs::directory_iterator(person_dir.path())) {
+            Mat img = imread(img_file.path().string(), IMREAD_GRAYSCALE);
+            if (img.empty()) continue;
+
+            vector<Rect> detected_faces;
+            face_cascade.detectMultiScale(img, detected_faces, 1.2, 5);
+
+            if (detected_faces.empty()) continue;
+
+            int num = 0;
+            for (const auto& face_rect : detected_faces) {
+                // if (face_rect.width < 100)  continue;
+
+                Mat face_img = img(face_rect).clone();
+                equalizeHist(face_img, face_img);
+                resize(face_img, face_img, Size(100, 100));
+                face_list.push_back(face_img);
+                class_list.push_back(idx);
+                imwrite(face_img_path + "/" + person + "_" + img_file.path().stem().string() + "_" + to_string(num) + ".jpg", face_img);
+                num++;
+            }
+        }
+    }
+
+    if (binary) {
+        string bin_name = string("lbph_model_class") + (uniform ? "_uniform" : "") + (u8 ? "_u8" : "") + ".bin";
+        if (!save_binary(face_list, class_list, uniform, u8, "./" + bin_name)) {
+            cerr << "Error: Cannot write " << bin_name << endl;
+            return 1;
+        }
+        cout << "Training complete. Model saved to " << bin_name << endl;
+        return 0;
+    }
+
+    // 建立 LBPH 臉部辨識器
+    Ptr<face::LBPHFaceRecognizer> face_recognizer = face::LBPHFaceRecognizer::create();
+    face_recognizer->train(face_list, class_list);
+
+    // 儲存模型
+    face_recognizer->save("./" + model_name);
+    cout << "Training complete. Model saved to " << model_name << endl;
+
+    return 0;
 }
\ No newline at end of file
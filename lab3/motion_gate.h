@@ -0,0 +1,108 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+// 偵測前的 frame differencing：只在有動的地方跑 cascade，整個畫面靜止就完全不跑
+// 以縮小後的灰階圖 (small_gray) 和上一張相減，threshold + dilate 之後找 blob，
+// 每個 blob 往外擴一圈當作偵測區域。每隔 full_scan_interval 張強制整張掃一次，
+// 避免站著不動的人或慢慢走進來的人一直沒被偵測到。
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct motion_config
+{
+    int threshold = 25;             // 像素差超過多少算有動
+    int min_area = 40;              // blob 外框面積下限 (small_gray 的 pixel)
+    double margin = 0.5;            // blob 往四周擴大的比例
+    int full_scan_interval = 30;    // 每幾張強制全掃
+    double full_scan_ratio = 0.6;   // 動的區域超過畫面這個比例就直接全掃
+};
+
+class motion_gate
+{
+public:
+    enum decision { SKIP, REGIONS, FULL };
+
+    explicit motion_gate(const motion_config &config = motion_config())
+        : cfg(config), frames_since_full(0) {}
+
+    // min_window 是 cascade 最小能偵測的大小，區域至少要這麼大才有意義
+    decision update(const cv::Mat &small_gray, cv::Size min_window, std::vector<cv::Rect> &regions)
+    {
+        regions.clear();
+        decision d = classify(small_gray, min_window, regions);
+        small_gray.copyTo(prev);
+        if (d == FULL) {
+            frames_since_full = 0;
+            regions.clear();
+            regions.push_back(cv::Rect(0, 0, small_gray.cols, small_gray.rows));
+        } else {
+            frames_since_full++;
+        }
+        return d;
+    }
+
+    void reset() { prev.release(); }
+
+private:
+    decision classify(const cv::Mat &cur, cv::Size min_window, std::vector<cv::Rect> &regions)
+    {
+        if (prev.empty() || prev.size() != cur.size()) return FULL;
+        if (frames_since_full + 1 >= cfg.full_scan_interval) return FULL;
+
+        cv::absdiff(cur, prev, diff);
+        cv::threshold(diff, mask, cfg.threshold, 255, cv::THRESH_BINARY);
+        // 把同一個人身上零碎的差異連成一塊
+        cv::dilate(mask, mask, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5)), cv::Point(-1, -1), 2);
+
+        std::vector<std::vector<cv::Point> > contours;
+        cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+        const cv::Rect bounds(0, 0, cur.cols, cur.rows);
+        for (const auto &c : contours) {
+            cv::Rect r = cv::boundingRect(c);
+            if (r.area() < cfg.min_area) continue;
+            int mx = std::max((int)(r.width * cfg.margin), min_window.width / 2);
+            int my = std::max((int)(r.height * cfg.margin), min_window.height / 2);
+            r = cv::Rect(r.x - mx, r.y - my, r.width + 2 * mx, r.height + 2 * my) & bounds;
+            if (r.width < min_window.width || r.height < min_window.height) continue;
+            regions.push_back(r);
+        }
+        if (regions.empty()) return SKIP;
+
+        merge_overlapping(regions);
+        long area = 0;
+        for (const auto &r : regions) area += r.area();
+        if (area > cfg.full_scan_ratio * bounds.area()) return FULL;
+        return REGIONS;
+    }
+
+    // 重疊的區域合併成外框，避免同一張臉在兩個區域各被偵測一次
+    static void merge_overlapping(std::vector<cv::Rect> &rects)
+    {
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < rects.size() && !merged; ++i) {
+                for (size_t j = i + 1; j < rects.size(); ++j) {
+                    if ((rects[i] & rects[j]).area() > 0) {
+                        rects[i] = rects[i] | rects[j];
+                        rects.erase(rects.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    motion_config cfg;
+    int frames_since_full;
+    cv::Mat prev;
+    cv::Mat diff;
+    cv::Mat mask;
+};
+
+#endif // MOTION_GATE_H
@@ -0,0 +1,259 @@
+// 用錄好的影片跑 lab3-1 同一份 pipeline，掃過 解析度 x 偵測縮小倍數 x scale factor，
+// 每組輸出一行 CSV：fps、各 stage p95、peak RSS、偵測數量。
+// 顯示端 (畫框 + letterbox、RGB565、寫 framebuffer) 和 lab3-1 同一份程式 (fb_output.h)，
+// 只是 framebuffer 換成記憶體，大小用 --fb 指定；沒有 mmap 的 /dev/fb0，fb_write 會比板子上快一點。
+// 只有 capture (解碼 + 縮放到目標解析度) 不算在 frame 時間裡。
+// 用法：
+//   ./pipeline_bench <model_path> <clip> [clip...] [--out bench.csv] [--frames 300]
+//                    [--res 640x480,1280x720,1280x960] [--downscale 1.5,2,3] [--scale 1.05,1.1,1.2]
+//                    [--native-detector] [--motion-gate] [--track] [--roi-redetect]
+//                    [--detect-threads N] [--recognize-interval N] [--recognize-threads N] [--pyramid-crops]
+//                    [--fb 1920x1080]
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/face.hpp>
+
+#include "face_pipeline.h"
+#include "fb_output.h"
+
+std::vector<std::string> split_list(const std::string &s)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+// /proc/self/status 的 VmHWM (kB)
+long read_peak_rss_kb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return atol(line.c_str() + 6);
+        }
+    }
+    return -1;
+}
+
+// 寫 5 到 clear_refs 會把 VmHWM 歸零 (Linux 4.0+)，舊 kernel 就只能拿到整個 process 的峰值
+bool reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (!clear_refs) return false;
+    clear_refs << "5";
+    return (bool)clear_refs;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model_path> <clip> [clip...] [--out file.csv] [--frames N]"
+                  << " [--res WxH,...] [--downscale d,...] [--scale s,...] [--cascade path] [--native-detector] [--motion-gate] [--track] [--roi-redetect] [--detect-threads N] [--recognize-interval N] [--recognize-threads N] [--pyramid-crops] [--fb WxH]" << std::endl;
+        return 1;
+    }
+    std::string model_path = argv[1];
+
+    std::vector<std::string> clips;
+    std::vector<std::string> resolutions = { "640x480", "1280x720", "1280x960" };
+    std::vector<std::string> downscales = { "1.5", "2", "3" };
+    std::vector<std::string> scale_factors = { "1.05", "1.1", "1.2" };
+    std::string out_path = "pipeline_bench.csv";
+    int max_frames = 300;
+    int fb_width = 1920, fb_height = 1080;
+    pipeline_config base_cfg;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            max_frames = atoi(argv[++i]);
+        } else if (arg == "--res" && i + 1 < argc) {
+            resolutions = split_list(argv[++i]);
+        } else if (arg == "--downscale" && i + 1 < argc) {
+            downscales = split_list(argv[++i]);
+        } else if (arg == "--scale" && i + 1 < argc) {
+            scale_factors = split_list(argv[++i]);
+        } else if (arg == "--fb" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &fb_width, &fb_height) != 2 || fb_width <= 0 || fb_height <= 0) {
+                std::cerr << "Error: Bad --fb value: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cascade" && i + 1 < argc) {
+            base_cfg.cascade_path = argv[++i];
+        } else if (arg == "--native-detector") {
+            base_cfg.native_detector = true;
+        } else if (arg == "--motion-gate") {
+            base_cfg.motion_gate = true;
+        } else if (arg == "--track") {
+            base_cfg.tracker = true;
+        } else if (arg == "--roi-redetect") {
+            base_cfg.roi_redetect = true;
+        } else if (arg == "--detect-threads" && i + 1 < argc) {
+            base_cfg.detect_threads = atoi(argv[++i]);
+        } else if (arg == "--recognize-interval" && i + 1 < argc) {
+            base_cfg.recog.interval = atoi(argv[++i]);
+        } else if (arg == "--recognize-threads" && i + 1 < argc) {
+            base_cfg.recognize_threads = atoi(argv[++i]);
+        } else if (arg == "--pyramid-crops") {
+            base_cfg.pyramid_crops = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            clips.push_back(arg);
+        }
+    }
+    if (clips.empty()) {
+        std::cerr << "Error: no input clip." << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv(out_path.c_str());
+    if (!csv) {
+        std::cerr << "Error: Could not open " << out_path << std::endl;
+        return 1;
+    }
+    csv << "clip,width,height,downscale,scale_factor,frames,fps,p95_frame_ms,"
+           "p95_gray_ms,p95_resize_ms,p95_detect_ms,p95_recognize_ms,"
+           "p95_compose_ms,p95_rgb565_ms,p95_fb_write_ms,peak_rss_kb,detections\n";
+
+    // window 開到 max_frames，percentile 才是整段而不是最後一小段
+    stage_stats stats(pipeline_stage_names(), (size_t)std::max(max_frames, 1));
+    stats.enable();
+
+    face_pipeline pipeline(base_cfg, stats);
+    if (!pipeline.load_cascade()) {
+        return 1;
+    }
+    pipeline.load_model(model_path);
+
+    bool rss_resettable = reset_peak_rss();
+    if (!rss_resettable) {
+        std::cerr << "Warning: cannot reset VmHWM, peak_rss_kb is the process-wide peak." << std::endl;
+    }
+
+    // 記憶體裡的 RGB565 framebuffer
+    framebuffer_info fb_info;
+    std::memset(&fb_info, 0, sizeof(fb_info));
+    fb_info.bits_per_pixel = 16;
+    fb_info.xres = fb_info.xres_virtual = fb_width;
+    fb_info.yres = fb_info.yres_virtual = fb_height;
+    fb_info.line_length = fb_width * 2;
+    fb_info.smem_len = (size_t)fb_info.line_length * fb_height;
+    std::vector<uint8_t> fb_mem(fb_info.smem_len);
+    const std::map<int, std::string> no_names;
+
+    std::vector<face_result> faces;
+    cv::Mat raw, frame;
+    for (const auto &clip : clips) {
+        for (const auto &res : resolutions) {
+            int width = 0, height = 0;
+            if (std::sscanf(res.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Warning: bad resolution " << res << ", skipped." << std::endl;
+                continue;
+            }
+            for (const auto &ds : downscales) {
+                for (const auto &sf : scale_factors) {
+                    pipeline_config cfg = base_cfg;
+                    cfg.small_scale = atof(ds.c_str());
+                    cfg.scale_factor = atof(sf.c_str());
+                    if (cfg.small_scale < 1.0 || cfg.scale_factor <= 1.0) {
+                        std::cerr << "Warning: bad downscale/scale " << ds << "/" << sf << ", skipped." << std::endl;
+                        continue;
+                    }
+                    if (!pipeline.reconfigure(cfg)) {
+                        return 1;
+                    }
+
+                    cv::VideoCapture cap(clip);
+                    if (!cap.isOpened()) {
+                        std::cerr << "Error: Could not open " << clip << std::endl;
+                        return 1;
+                    }
+
+                    stats.reset_window();
+                    if (rss_resettable) reset_peak_rss();
+
+                    std::vector<double> frame_ms;
+                    frame_ms.reserve(max_frames);
+                    long detections = 0;
+                    double total_ms = 0.0;
+                    int n = 0;
+                    while (n < max_frames) {
+                        // 解碼和縮放到目標解析度模擬 capture，不算進 pipeline 時間
+                        stats.begin(STAGE_CAPTURE);
+                        bool ok = cap.read(raw);
+                        if (ok) {
+                            if (raw.cols != width || raw.rows != height) {
+                                cv::resize(raw, frame, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+                            } else {
+                                frame = raw;
+                            }
+                        }
+                        stats.end(STAGE_CAPTURE);
+                        if (!ok || raw.empty()) break;
+
+                        auto t0 = std::chrono::steady_clock::now();
+                        pipeline.process(frame, faces);
+
+                        stats.begin(STAGE_COMPOSE);
+                        draw_faces(frame, faces, pipeline.enrollment(), no_names, pipeline.has_model());
+                        cv::Mat background = letterbox_to_fb(frame, fb_width, fb_height,
+                                                             &pipeline.pyramid(), &pipeline.buffers_pool());
+                        stats.end(STAGE_COMPOSE);
+                        write_to_fb(background, fb_info, &fb_mem[0], stats);
+                        pipeline.buffers_pool().release(background);
+                        auto t1 = std::chrono::steady_clock::now();
+                        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+                        frame_ms.push_back(ms);
+                        total_ms += ms;
+                        detections += (long)faces.size();
+                        stats.end_frame();
+                        n++;
+                    }
+                    if (n == 0) {
+                        std::cerr << "Warning: " << clip << " has no frames." << std::endl;
+                        continue;
+                    }
+
+                    char line[512];
+                    std::snprintf(line, sizeof(line), "%s,%d,%d,%s,%s,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%ld,%ld\n",
+                                  clip.c_str(), width, height, ds.c_str(), sf.c_str(), n,
+                                  total_ms > 0 ? n * 1000.0 / total_ms : 0.0,
+                                  percentile(frame_ms, 0.95),
+                                  stats.stage_percentile(STAGE_GRAY, 0.95),
+                                  stats.stage_percentile(STAGE_RESIZE, 0.95),
+                                  stats.stage_percentile(STAGE_DETECT, 0.95),
+                                  stats.stage_percentile(STAGE_RECOGNIZE, 0.95),
+                                  stats.stage_percentile(STAGE_COMPOSE, 0.95),
+                                  stats.stage_percentile(STAGE_CONVERT, 0.95),
+                                  stats.stage_percentile(STAGE_FB_WRITE, 0.95),
+                                  read_peak_rss_kb(), detections);
+                    csv << line;
+                    csv.flush();
+                    std::cerr << line;
+                }
+            }
+        }
+    }
+
+    std::cout << "Benchmark complete. Results saved to " << out_path << std::endl;
+    return 0;
+}
@@ -0,0 +1,131 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+// 偵測前處理：原本是 全尺寸 cvtColor → 全尺寸 equalizeHist → resize 1/2，
+// equalize 做了偵測用不到的 4 倍 pixel，而且整張圖被讀寫了三次。
+// 這裡一次掃過 frame，每次處理幾列 (還在 cache 裡)：
+//   1. 轉灰階，寫到全尺寸 gray (辨識切臉用，不做 equalize)
+//   2. 同時累加全尺寸 gray 的 histogram
+//   3. 同時做 2x2 平均得到半尺寸圖 (和 INTER_LINEAR 縮 1/2 的結果相同)
+// 最後用 histogram 算出 equalize 的查表，只套在半尺寸圖上。
+// 查表和對全尺寸 gray 做 equalizeHist 的查表完全相同，辨識切臉時再套到小小的臉上，
+// 結果和原本「整張 equalize 再切」一樣。
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <opencv2/opencv.hpp>
+
+class frame_preprocessor
+{
+public:
+    frame_preprocessor() : lut(1, 256, CV_8U), half_valid(false) {}
+
+    // 掃過 frame 得到全尺寸 gray、histogram 和還沒 equalize 的縮小圖。
+    // small_scale 不是 2 (或大小是奇數) 時改走一般的 resize，histogram 一樣只算一次
+    void sweep(const cv::Mat &frame, double small_scale, cv::Mat &gray)
+    {
+        int hist[4][256];
+        std::memset(hist, 0, sizeof(hist));
+        gray.create(frame.size(), CV_8U);
+
+        bool half = small_scale == 2.0 && frame.cols % 2 == 0 && frame.rows % 2 == 0;
+        half_valid = half;
+        if (half) {
+            small_raw.create(frame.rows / 2, frame.cols / 2, CV_8U);
+        }
+
+        const int strip = 8;    // 一次處理的列數 (偶數)，BGR 1280 寬約 30 KB
+        for (int y = 0; y < frame.rows; y += strip) {
+            int rows = std::min(strip, frame.rows - y);
+            cv::Mat dst = gray.rowRange(y, y + rows);
+            if (frame.channels() == 1) {
+                frame.rowRange(y, y + rows).copyTo(dst);
+            } else {
+                cv::cvtColor(frame.rowRange(y, y + rows), dst, cv::COLOR_BGR2GRAY);
+            }
+            for (int r = 0; r < rows; ++r) {
+                accumulate(dst.ptr<uint8_t>(r), dst.cols, hist);
+            }
+            if (half) {
+                for (int r = 0; r < rows; r += 2) {
+                    downscale_rows(dst.ptr<uint8_t>(r), dst.ptr<uint8_t>(r + 1),
+                                   small_raw.ptr<uint8_t>((y + r) / 2), small_raw.cols);
+                }
+            }
+        }
+        if (!half) {
+            cv::resize(gray, small_raw, cv::Size(), 1.0 / small_scale, 1.0 / small_scale);
+        }
+
+        build_lut(hist, (int)gray.total());
+    }
+
+    // 縮小圖套上 equalize 查表
+    void equalize_small(cv::Mat &small_gray) const
+    {
+        cv::LUT(small_raw, lut, small_gray);
+    }
+
+    // 掃描時順便算好的 1/2 灰階 (沒有 equalize)，small_scale 不是 2 時是空的
+    cv::Mat half_image() const { return half_valid ? small_raw : cv::Mat(); }
+
+    // 把全尺寸 gray 的一塊套上 equalize 查表 (等同於整張 equalizeHist 之後再切)
+    void equalize(const cv::Mat &src, cv::Mat &dst) const
+    {
+        cv::LUT(src, lut, dst);
+    }
+
+private:
+    // 四份 histogram 輪流加，連續相同的 pixel 才不會卡在同一個記憶體位置的讀寫相依
+    static void accumulate(const uint8_t *p, int n, int hist[4][256])
+    {
+        int x = 0;
+        for (; x + 4 <= n; x += 4) {
+            hist[0][p[x]]++;
+            hist[1][p[x + 1]]++;
+            hist[2][p[x + 2]]++;
+            hist[3][p[x + 3]]++;
+        }
+        for (; x < n; ++x) hist[0][p[x]]++;
+    }
+
+    // INTER_LINEAR 剛好縮一半時權重都是 0.5，定點數結果是 (四個相加 + 2) >> 2
+    static void downscale_rows(const uint8_t *r0, const uint8_t *r1, uint8_t *out, int w)
+    {
+        for (int x = 0; x < w; ++x) {
+            out[x] = (uint8_t)((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+        }
+    }
+
+    // 和 cv::equalizeHist 相同的查表
+    void build_lut(int hist[4][256], int total)
+    {
+        int h[256];
+        for (int i = 0; i < 256; ++i) h[i] = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+
+        uint8_t *t = lut.ptr<uint8_t>();
+        int i = 0;
+        while (i < 255 && !h[i]) ++i;
+        if (h[i] == total) {
+            // 整張只有一個灰階值，equalizeHist 會原樣輸出
+            for (int k = 0; k < 256; ++k) t[k] = (uint8_t)k;
+            return;
+        }
+        float scale = 255.f / (total - h[i]);
+        int sum = 0;
+        for (int k = 0; k < i; ++k) t[k] = 0;
+        t[i++] = 0;
+        for (; i < 256; ++i) {
+            sum += h[i];
+            t[i] = cv::saturate_cast<uint8_t>(sum * scale);
+        }
+    }
+
+    cv::Mat lut;
+    cv::Mat small_raw;
+    bool half_valid;
+};
+
+#endif // PREPROCESS_H
@@ -0,0 +1,130 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+// 每張 frame 共用的影像 pyramid
+// 偵測用的 1/2 圖、辨識用的 100x100 臉、顯示用的縮圖原本各自從全尺寸 resize，
+// 這裡改成第一次有人要某一層時才用 2x2 平均 (INTER_AREA 剛好縮一半的快速路徑) 算出來，
+// 之後同一張 frame 的其他 stage 直接拿。
+// 每一層的記憶體從 mat_pool 借，frame 換下一張時還回去，穩定之後每張 frame 都不用再 malloc。
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// 同樣大小和型別的 cv::Mat 重複使用
+class mat_pool
+{
+public:
+    explicit mat_pool(size_t max_free = 16) : limit(max_free) {}
+
+    cv::Mat acquire(cv::Size size, int type)
+    {
+        for (size_t i = 0; i < free_list.size(); ++i) {
+            if (free_list[i].size() == size && free_list[i].type() == type) {
+                cv::Mat m = free_list[i];
+                free_list.erase(free_list.begin() + i);
+                return m;
+            }
+        }
+        return cv::Mat(size, type);
+    }
+
+    // 只收沒有別人在用的 buffer，不然下一個借的人會寫到別人手上的資料
+    void release(cv::Mat &m)
+    {
+        if (!m.empty() && m.u && m.u->refcount == 1 && m.isContinuous() && free_list.size() < limit) {
+            free_list.push_back(m);
+        }
+        m.release();
+    }
+
+private:
+    size_t limit;
+    std::vector<cv::Mat> free_list;
+};
+
+class frame_pyramid
+{
+public:
+    static const int max_levels = 6;
+
+    explicit frame_pyramid(mat_pool &buffers) : pool(buffers) {}
+    ~frame_pyramid() { retire(); }
+
+    // 新的一張 frame。gray 是全尺寸灰階，half 是前處理已經順便算好的 1/2 灰階 (沒有就傳空的)，
+    // color 是原始 BGR frame (只存 header，顯示前畫上去的框也會在縮圖裡)
+    void reset(const cv::Mat &gray, const cv::Mat &half, const cv::Mat &color)
+    {
+        retire();
+        gray_levels[0] = gray;
+        color_levels[0] = color;
+        if (!half.empty()) gray_levels[1] = half;
+    }
+
+    // 上一張 frame 的各層還給 pool
+    void retire()
+    {
+        for (int k = 0; k < max_levels; ++k) {
+            if (k > 0) {
+                if (owned_gray[k]) pool.release(gray_levels[k]);
+                if (owned_color[k]) pool.release(color_levels[k]);
+            }
+            gray_levels[k].release();
+            color_levels[k].release();
+            owned_gray[k] = owned_color[k] = false;
+        }
+    }
+
+    // 第 k 層 = 原尺寸的 1/2^k，太小 (短邊 < 16) 時回傳空的 Mat
+    const cv::Mat &gray_level(int k) { return level(gray_levels, owned_gray, k); }
+    const cv::Mat &color_level(int k) { return level(color_levels, owned_color, k); }
+
+    // 縮成 out 大小至少要從哪一層開始 (層越高越省)
+    int level_for(cv::Size src, cv::Size out) const
+    {
+        int k = 0;
+        while (k + 1 < max_levels && (src.width >> (k + 1)) >= out.width && (src.height >> (k + 1)) >= out.height) {
+            ++k;
+        }
+        return k;
+    }
+
+    // r (全尺寸座標) 要縮到 out 時的來源：最高但切出來還不小於 out 的那一層的 ROI
+    cv::Mat crop_source(const cv::Rect &r, cv::Size out)
+    {
+        for (int k = level_for(r.size(), out); k > 0; --k) {
+            const cv::Mat &lv = gray_level(k);
+            if (lv.empty()) continue;
+            cv::Rect s(r.x >> k, r.y >> k, r.width >> k, r.height >> k);
+            s &= cv::Rect(0, 0, lv.cols, lv.rows);
+            if (s.width < out.width || s.height < out.height) continue;
+            return lv(s);
+        }
+        return gray_levels[0](r);
+    }
+
+private:
+    const cv::Mat &level(cv::Mat *levels, bool *owned, int k)
+    {
+        static const cv::Mat none;
+        if (k < 0 || k >= max_levels || levels[0].empty()) return none;
+        if (k == 0 || !levels[k].empty()) return levels[k];
+
+        const cv::Mat &prev = level(levels, owned, k - 1);
+        if (prev.empty() || prev.cols / 2 < 16 || prev.rows / 2 < 16) return none;
+        cv::Size half(prev.cols / 2, prev.rows / 2);
+        levels[k] = pool.acquire(half, prev.type());
+        owned[k] = true;
+        // 奇數大小時去掉最後一列/行，INTER_AREA 才會走整數倍的快速路徑
+        cv::resize(prev(cv::Rect(0, 0, half.width * 2, half.height * 2)), levels[k], half, 0, 0, cv::INTER_AREA);
+        return levels[k];
+    }
+
+    mat_pool &pool;
+    cv::Mat gray_levels[max_levels];
+    cv::Mat color_levels[max_levels];
+    bool owned_gray[max_levels] = {};
+    bool owned_color[max_levels] = {};
+};
+
+#endif // PYRAMID_H
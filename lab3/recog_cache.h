@@ -0,0 +1,130 @@
+#ifndef RECOG_CACHE_H
+#define RECOG_CACHE_H
+
+// 每個 track 的辨識結果快取
+// 同一個人站在鏡頭前不會每張 frame 都變，所以只在下面幾種情況重新 predict：
+//   - 新的 track
+//   - 距離上次 predict 已經 interval 張
+//   - 框的大小或位置變很多 (走近、轉頭、換了一張臉)
+//   - 上次的距離 (LBPH confidence) 太大，還不確定是誰
+// 顯示的 label 是這個 track 歷次 predict 的加權投票，距離越小權重越大，
+// 舊的票每次乘上 decay，人真的換了也能在幾次之內換過來。
+// Unknown (label -1，被 open-set 門檻擋掉) 也算一票，陌生人走進來才換得成 Unknown；
+// 沒有距離的結果 (模型是空的，DBL_MAX) 不投票，只記下距離。
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <map>
+
+#include <opencv2/opencv.hpp>
+
+struct recog_cache_config
+{
+    int interval = 0;               // 每幾張重新 predict 一次，0 = 不快取，每張都 predict (預設)
+    double retry_confidence = 70.0; // 距離大於這個值時每張都重新 predict
+    double max_scale_change = 0.2;  // 框寬變化超過這個比例就重新 predict
+    double max_shift = 0.5;         // 框中心移動超過框寬的這個比例就重新 predict
+    double decay = 0.8;             // 每次新的一票進來時舊票的權重
+    int expire_frames = 30;         // track 消失幾張之後丟掉快取
+};
+
+class recognition_cache
+{
+public:
+    explicit recognition_cache(const recog_cache_config &config = recog_cache_config())
+        : cfg(config), frame(0) {}
+
+    bool enabled() const { return cfg.interval > 0; }
+
+    // 這張 frame 這個 track 需不需要重新 predict
+    bool need_predict(int id, const cv::Rect &box) const
+    {
+        if (!enabled()) return true;
+        auto it = entries.find(id);
+        if (it == entries.end()) return true;
+        const entry &e = it->second;
+        if (frame - e.predicted_frame >= cfg.interval) return true;
+        if (e.last_confidence > cfg.retry_confidence) return true;
+        double w = std::max(e.box.width, 1);
+        if (std::abs(box.width - e.box.width) > cfg.max_scale_change * w) return true;
+        double dx = (box.x + box.width * 0.5) - (e.box.x + e.box.width * 0.5);
+        double dy = (box.y + box.height * 0.5) - (e.box.y + e.box.height * 0.5);
+        return dx * dx + dy * dy > cfg.max_shift * cfg.max_shift * w * w;
+    }
+
+    // 新的 predict 結果投進去
+    void add(int id, const cv::Rect &box, int label, double confidence)
+    {
+        entry &e = entries[id];
+        e.box = box;
+        e.predicted_frame = frame;
+        e.last_confidence = confidence;
+        e.seen_frame = frame;
+        if (confidence >= DBL_MAX) return;
+        for (auto &v : e.votes) {
+            v.second.weight *= cfg.decay;
+            v.second.weighted_confidence *= cfg.decay;
+        }
+        double w = 1.0 / (1.0 + std::max(confidence, 0.0));
+        vote &v = e.votes[label];
+        v.weight += w;
+        v.weighted_confidence += w * confidence;
+    }
+
+    // 投票結果；沒有任何票時 label = -1，confidence 是上次 predict 的距離
+    // (沒 predict 過的 track 不動 label / confidence)
+    void result(int id, int &label, double &confidence)
+    {
+        auto it = entries.find(id);
+        if (it == entries.end()) return;
+        it->second.seen_frame = frame;
+        label = -1;
+        confidence = it->second.last_confidence;
+        double best = 0.0;
+        for (const auto &v : it->second.votes) {
+            if (v.second.weight > best) {
+                best = v.second.weight;
+                label = v.first;
+                confidence = v.second.weighted_confidence / v.second.weight;
+            }
+        }
+    }
+
+    // 每張 frame 結束呼叫一次，很久沒出現的 track 丟掉
+    void end_frame()
+    {
+        frame++;
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (frame - it->second.seen_frame > cfg.expire_frames) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void reset() { entries.clear(); }
+
+private:
+    struct vote
+    {
+        double weight = 0.0;
+        double weighted_confidence = 0.0;
+    };
+
+    struct entry
+    {
+        cv::Rect box;               // 上次 predict 時的框
+        long predicted_frame = 0;
+        long seen_frame = 0;
+        double last_confidence = 0.0;
+        std::map<int, vote> votes;  // label → 票 (-1 = Unknown)
+    };
+
+    recog_cache_config cfg;
+    long frame;
+    std::map<int, entry> entries;
+};
+
+#endif // RECOG_CACHE_H
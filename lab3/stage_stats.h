@@ -0,0 +1,412 @@
+#ifndef STAGE_STATS_H
+#define STAGE_STATS_H
+
+// 每個 pipeline stage 的延遲統計 (mean / p50 / p95 / max)，
+// 並可選擇用 perf_event_open 量測 cycles、instructions、L1D miss、LLC miss，
+// 用來判斷一個 kernel 是卡在記憶體還是運算。
+// 在 container 或 perf_event_paranoid 限制的 kernel 上打不開計數器時，
+// 只會印一次警告，延遲統計照常運作。
+//
+// 計數器是 per-thread 的 (perf_event_open 的 pid 是 thread id，沒有 inherit：
+// inherit 只算之後才開的 thread，而且要等 thread 結束才加回來，常駐的 pool 用不上)。
+// work_pool 的 thread 要用 add_threads 登記，每個 thread 各開一組，stage 的值是所有 thread 的總和；
+// 沒登記的 thread (OpenCV 自己的 thread、熱更新的背景 thread) 不算在內。
+
+#include <unistd.h>
+#include <errno.h>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+// 第 p 個百分位 (0~1，取最近的那個 sample)；samples 是複本，nth_element 不會動到呼叫端的資料
+inline double percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty()) return 0.0;
+    size_t k = (size_t)(p * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+class perf_counters
+{
+public:
+    enum { CYCLES, INSTRUCTIONS, L1D_MISS, LLC_MISS, NUM_COUNTERS };
+
+    perf_counters() : leader_fd(-1), num_open(0)
+    {
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            fds[i] = -1;
+            slot[i] = -1;
+        }
+    }
+
+    ~perf_counters() { close_all(); }
+
+    // 開啟 tid 這個 thread 的計數器，0 = calling thread (只算 user space，paranoid=2 也能開)
+    // 回傳 false 代表一個都開不起來
+    bool open(pid_t tid = 0)
+    {
+        static const uint32_t types[NUM_COUNTERS] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+        };
+        static const uint64_t configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            int fd = open_one(types[i], configs[i], tid);
+            // Cortex-A9 的 PMU 沒有 LL cache event，退回 generic cache-misses
+            if (fd < 0 && i == LLC_MISS) {
+                fd = open_one(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, tid);
+            }
+            if (fd < 0) {
+                if (first_errno == 0) first_errno = errno;
+                continue;
+            }
+            if (leader_fd < 0) leader_fd = fd;
+            fds[i] = fd;
+            slot[i] = num_open++;
+        }
+        if (leader_fd < 0) return false;
+
+        ioctl(leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    bool available(int idx) const { return fds[idx] >= 0; }
+    bool any_available() const { return leader_fd >= 0; }
+    int open_errno() const { return first_errno; }
+
+    // 一次 read() 取得整個 group，並記下 enabled/running 時間做 multiplex 校正
+    bool read(uint64_t values[NUM_COUNTERS], uint64_t &time_enabled, uint64_t &time_running) const
+    {
+        if (leader_fd < 0) return false;
+        uint64_t buf[3 + NUM_COUNTERS];
+        ssize_t n = ::read(leader_fd, buf, sizeof(buf));
+        if (n < (ssize_t)(3 * sizeof(uint64_t))) return false;
+        time_enabled = buf[1];
+        time_running = buf[2];
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            values[i] = (slot[i] >= 0 && (uint64_t)slot[i] < buf[0]) ? buf[3 + slot[i]] : 0;
+        }
+        return true;
+    }
+
+private:
+    int open_one(uint32_t type, uint64_t config, pid_t tid)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = (leader_fd < 0) ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(__NR_perf_event_open, &attr, tid, -1, leader_fd, 0);
+    }
+
+    void close_all()
+    {
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            if (fds[i] >= 0) close(fds[i]);
+            fds[i] = -1;
+        }
+        leader_fd = -1;
+        num_open = 0;
+    }
+
+    int fds[NUM_COUNTERS];
+    int slot[NUM_COUNTERS];     // 在 group read buffer 中的位置
+    int leader_fd;
+    int num_open;
+    int first_errno = 0;
+};
+
+class stage_stats
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit stage_stats(const std::vector<std::string> &stage_names, size_t window = 256)
+        : names(stage_names), window_size(window), enabled(false), perf_enabled(false), frames(0)
+    {
+        stages.resize(names.size());
+        for (auto &s : stages) s.samples.reserve(window_size);
+        window_start = clock::now();
+    }
+
+    void enable() { enabled = true; }
+    bool is_enabled() const { return enabled; }
+
+    // 打不開時印一次原因就好，不影響延遲統計
+    void enable_perf()
+    {
+        enabled = true;
+        if (perf.open()) {
+            perf_enabled = true;
+            if (!perf.available(perf_counters::L1D_MISS) || !perf.available(perf_counters::LLC_MISS)) {
+                std::cerr << "Warning: some cache counters are not supported by this PMU, reported as n/a." << std::endl;
+            }
+            for (auto &t : threads) open_thread(t);
+        } else {
+            std::cerr << "Warning: perf_event_open unavailable (" << std::strerror(perf.open_errno())
+                      << "), reporting latency only." << std::endl;
+        }
+    }
+
+    // work_pool 的 thread 登記進來 (在 enable_perf 之前或之後都可以)，之後每個 stage 的計數器都加上它們的
+    void add_threads(const std::vector<pid_t> &tids)
+    {
+        for (pid_t tid : tids) {
+            thread_slot t;
+            t.tid = tid;
+            if (perf_enabled) open_thread(t);
+            threads.push_back(std::move(t));
+        }
+    }
+
+    // pool 換掉時把舊的 thread 拿掉 (不能在 begin / end 之間呼叫)
+    void remove_threads(const std::vector<pid_t> &tids)
+    {
+        threads.erase(std::remove_if(threads.begin(), threads.end(), [&](const thread_slot &t) {
+            return std::find(tids.begin(), tids.end(), t.tid) != tids.end();
+        }), threads.end());
+    }
+
+    void begin(int stage)
+    {
+        if (!enabled) return;
+        stage_slot &s = stages[stage];
+        if (perf_enabled) {
+            s.starts.resize(1 + threads.size());
+            for (size_t g = 0; g < s.starts.size(); ++g) {
+                const perf_counters *pc = group(g);
+                perf_start &st = s.starts[g];
+                st.ok = pc && pc->read(st.values, st.enabled, st.running);
+            }
+        }
+        s.start = clock::now();
+    }
+
+    // 同一張 frame 裡同一個 stage 可以 begin/end 好幾段 (例如 tracker predict、correct 和 ID 關聯)，
+    // 各段加總，end_frame 時才記成一筆
+    void end(int stage)
+    {
+        if (!enabled) return;
+        clock::time_point now = clock::now();
+        stage_slot &s = stages[stage];
+        s.frame_ms += std::chrono::duration<double, std::milli>(now - s.start).count();
+        s.frame_ran = true;
+
+        // calling thread 和每個 pool thread 各自做 multiplex 校正後加起來
+        for (size_t g = 0; perf_enabled && g < s.starts.size(); ++g) {
+            const perf_counters *pc = group(g);
+            const perf_start &st = s.starts[g];
+            uint64_t values[perf_counters::NUM_COUNTERS];
+            uint64_t enabled_ns, running_ns;
+            if (!st.ok || !pc->read(values, enabled_ns, running_ns)) continue;
+            uint64_t d_enabled = enabled_ns - st.enabled;
+            uint64_t d_running = running_ns - st.running;
+            double scale = (d_running > 0) ? (double)d_enabled / (double)d_running : 0.0;
+            for (int i = 0; i < perf_counters::NUM_COUNTERS; ++i) {
+                s.frame_counters[i] += (double)(values[i] - st.values[i]) * scale;
+            }
+            if (g == 0) s.frame_counters_ok = true;
+        }
+    }
+
+    // 一張 frame 結束：這張有跑的 stage 各記一筆，然後 frame_ms / ran 歸零，
+    // 下一張沒跑的 stage 才不會報上一張的時間
+    void end_frame()
+    {
+        if (enabled) frames++;
+        for (auto &s : stages) {
+            if (s.frame_ran) {
+                if (s.samples.size() < window_size) {
+                    s.samples.push_back(s.frame_ms);
+                } else {
+                    s.samples[s.next++ % window_size] = s.frame_ms;
+                }
+                s.sum_ms += s.frame_ms;
+                s.count++;
+            }
+            if (s.frame_counters_ok) {
+                for (int i = 0; i < perf_counters::NUM_COUNTERS; ++i) s.counter_sum[i] += s.frame_counters[i];
+                s.counter_count++;
+            }
+            s.frame_ms = 0;
+            s.frame_ran = false;
+            s.frame_counters_ok = false;
+            for (int i = 0; i < perf_counters::NUM_COUNTERS; ++i) s.frame_counters[i] = 0;
+        }
+    }
+    uint64_t frame_count() const { return frames; }
+
+    // 印出目前視窗的統計後清空累計值
+    void report(std::ostream &os)
+    {
+        if (!enabled) return;
+        clock::time_point now = clock::now();
+        double elapsed = std::chrono::duration<double>(now - window_start).count();
+        char line[256];
+
+        std::snprintf(line, sizeof(line), "[stats] %llu frames, %.2f fps\n",
+                      (unsigned long long)frames, elapsed > 0 ? frames / elapsed : 0.0);
+        os << line;
+        std::snprintf(line, sizeof(line), "%-12s %8s %8s %8s %8s", "stage", "mean", "p50", "p95", "max(ms)");
+        os << line;
+        if (perf_enabled) {
+            std::snprintf(line, sizeof(line), " %10s %10s %6s %9s %9s", "Mcycles", "Minstr", "IPC", "L1D-MPKI", "LLC-MPKI");
+            os << line;
+        }
+        os << "\n";
+
+        for (size_t i = 0; i < stages.size(); ++i) {
+            stage_slot &s = stages[i];
+            if (s.count == 0) continue;
+            std::snprintf(line, sizeof(line), "%-12s %8.2f %8.2f %8.2f %8.2f", names[i].c_str(),
+                          s.sum_ms / s.count, percentile(s.samples, 0.50),
+                          percentile(s.samples, 0.95), percentile(s.samples, 1.0));
+            os << line;
+            if (perf_enabled) {
+                os << format_counters(s);
+            }
+            os << "\n";
+        }
+        os.flush();
+        reset_window();
+    }
+
+    // 給 headless / benchmark 使用：目前視窗內某個 stage 的 percentile
+    double stage_percentile(int stage, double p) const { return percentile(stages[stage].samples, p); }
+    double stage_mean(int stage) const { return stages[stage].count ? stages[stage].sum_ms / stages[stage].count : 0.0; }
+    // 目前這張 frame (上次 end_frame 之後) 這個 stage 花的時間，跑了好幾段時是總和；沒跑過是 0
+    double frame_ms(int stage) const { return stages[stage].frame_ms; }
+    bool ran(int stage) const { return stages[stage].frame_ran; }
+    const std::vector<std::string> &stage_names() const { return names; }
+
+    void reset_window()
+    {
+        for (auto &s : stages) {
+            s.samples.clear();
+            s.next = 0;
+            s.sum_ms = 0;
+            s.count = 0;
+            s.counter_count = 0;
+            for (int k = 0; k < perf_counters::NUM_COUNTERS; ++k) s.counter_sum[k] = 0;
+        }
+        frames = 0;
+        window_start = clock::now();
+    }
+
+private:
+    struct perf_start
+    {
+        bool ok = false;
+        uint64_t values[perf_counters::NUM_COUNTERS] = {};
+        uint64_t enabled = 0;
+        uint64_t running = 0;
+    };
+
+    struct thread_slot
+    {
+        pid_t tid;
+        std::unique_ptr<perf_counters> counters;    // 打不開時是空的
+    };
+
+    struct stage_slot
+    {
+        clock::time_point start;
+        std::vector<double> samples;    // 最近 window_size 筆延遲 (ms)
+        size_t next = 0;
+        double sum_ms = 0;
+        uint64_t count = 0;
+        double frame_ms = 0;            // 這張 frame 的累計 (end_frame 歸零)
+        bool frame_ran = false;
+        double frame_counters[perf_counters::NUM_COUNTERS] = {};
+        bool frame_counters_ok = false;
+
+        std::vector<perf_start> starts; // begin 時每組計數器的值 (0 = calling thread，之後是 threads)
+        double counter_sum[perf_counters::NUM_COUNTERS] = {};
+        uint64_t counter_count = 0;
+    };
+
+    // 第 g 組計數器：0 是 calling thread，之後是登記的 pool thread (打不開的是 nullptr)
+    const perf_counters *group(size_t g) const { return g == 0 ? &perf : threads[g - 1].counters.get(); }
+
+    void open_thread(thread_slot &t)
+    {
+        std::unique_ptr<perf_counters> pc(new perf_counters());
+        if (pc->open(t.tid)) t.counters = std::move(pc);
+    }
+
+    static void fmt_or_na(char (&out)[16], bool ok, double v)
+    {
+        if (ok) std::snprintf(out, sizeof(out), "%.2f", v);
+        else std::snprintf(out, sizeof(out), "n/a");
+    }
+
+    std::string format_counters(const stage_slot &s) const
+    {
+        char buf[128];
+        if (s.counter_count == 0) {
+            std::snprintf(buf, sizeof(buf), " %10s %10s %6s %9s %9s", "n/a", "n/a", "n/a", "n/a", "n/a");
+            return buf;
+        }
+        double n = (double)s.counter_count;
+        double cyc = s.counter_sum[perf_counters::CYCLES] / n;
+        double ins = s.counter_sum[perf_counters::INSTRUCTIONS] / n;
+        bool have_ins = perf.available(perf_counters::INSTRUCTIONS) && ins > 0;
+        bool have_ipc = have_ins && perf.available(perf_counters::CYCLES) && cyc > 0;
+        char c_cyc[16], c_ins[16], c_ipc[16], c_l1[16], c_llc[16];
+        fmt_or_na(c_cyc, perf.available(perf_counters::CYCLES), cyc / 1e6);
+        fmt_or_na(c_ins, have_ins, ins / 1e6);
+        fmt_or_na(c_ipc, have_ipc, have_ipc ? ins / cyc : 0.0);
+        // 以每千道指令的 miss 數 (MPKI) 表示，跨 stage 才好比較
+        fmt_or_na(c_l1, have_ins && perf.available(perf_counters::L1D_MISS),
+                  have_ins ? s.counter_sum[perf_counters::L1D_MISS] / n * 1000.0 / ins : 0.0);
+        fmt_or_na(c_llc, have_ins && perf.available(perf_counters::LLC_MISS),
+                  have_ins ? s.counter_sum[perf_counters::LLC_MISS] / n * 1000.0 / ins : 0.0);
+        std::snprintf(buf, sizeof(buf), " %10s %10s %6s %9s %9s", c_cyc, c_ins, c_ipc, c_l1, c_llc);
+        return buf;
+    }
+
+    std::vector<std::string> names;
+    std::vector<stage_slot> stages;
+    size_t window_size;
+    bool enabled;
+    bool perf_enabled;
+    perf_counters perf;
+    std::vector<thread_slot> threads;
+    uint64_t frames;
+    clock::time_point window_start;
+};
+
+// RAII 版本，離開 scope 時自動 end()
+class stage_scope
+{
+public:
+    stage_scope(stage_stats &s, int stage) : stats(s), id(stage) { stats.begin(id); }
+    ~stage_scope() { stats.end(id); }
+private:
+    stage_stats &stats;
+    int id;
+};
+
+#endif // STAGE_STATS_H
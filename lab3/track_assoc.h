@@ -0,0 +1,176 @@
+#ifndef TRACK_ASSOC_H
+#define TRACK_ASSOC_H
+
+// 偵測框 → track 的關聯：每張臉一個不變的 ID，框用 Kalman filter 平滑
+// 每張 frame 先用等速模型預測每個 track 的框，和這張的偵測框算 IoU，
+// 由 IoU 大的先配；配到的用偵測框更新 filter，沒配到的偵測開新 track。
+// 沒配到的 track 開 smooth 時最多用預測的框撐 max_coast 張，偵測偶爾漏掉一張框也不會閃。
+// 中心和寬高各用一個 1 維的 [位置, 速度] filter，彼此獨立，計算量很小。
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct assoc_config
+{
+    double min_iou = 0.3;           // 預測框和偵測框的 IoU 超過這個值才算同一張臉
+    bool smooth = false;            // true: 輸出 Kalman 平滑後的框，false: 輸出原本的偵測框
+    int max_coast = 2;              // smooth 時沒偵測到的 track 最多再顯示幾張
+    double measure_noise = 0.05;    // 偵測框位置的標準差 (框寬的比例)
+    double process_noise = 0.03;    // 每張 frame 速度變化的標準差 (框寬的比例)
+};
+
+inline double box_iou(const cv::Rect &a, const cv::Rect &b)
+{
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+// 1 維等速模型：狀態 [p, v]，只量測 p
+struct kalman_1d
+{
+    double p, v;
+    double P00, P01, P11;
+
+    void init(double z, double var)
+    {
+        p = z;
+        v = 0.0;
+        P00 = var;
+        P01 = 0.0;
+        P11 = var;
+    }
+
+    // P = F P F' + Q，F = [1 1; 0 1]，Q 是等加速度白雜訊
+    void predict(double q)
+    {
+        p += v;
+        P00 += 2.0 * P01 + P11 + q * 0.25;
+        P01 += P11 + q * 0.5;
+        P11 += q;
+    }
+
+    void update(double z, double r)
+    {
+        double s = P00 + r;
+        double k0 = P00 / s, k1 = P01 / s;
+        double y = z - p;
+        p += k0 * y;
+        v += k1 * y;
+        P11 -= k1 * P01;
+        P01 *= 1.0 - k0;
+        P00 *= 1.0 - k0;
+    }
+};
+
+class track_associator
+{
+public:
+    explicit track_associator(const assoc_config &config = assoc_config())
+        : cfg(config), next_id(0) {}
+
+    // detections → out (同樣的順序不保證)，ids 和 out 一一對應
+    void update(const std::vector<cv::Rect> &detections, std::vector<cv::Rect> &out, std::vector<int> &ids)
+    {
+        for (auto &t : tracks) {
+            double w = std::max(t.k[2].p, 1.0);
+            double q = sq(cfg.process_noise * w);
+            for (int i = 0; i < 4; ++i) t.k[i].predict(q);
+        }
+
+        // IoU 由大到小貪婪配對
+        std::vector<pair_score> pairs;
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            cv::Rect pred = tracks[i].predicted();
+            for (size_t j = 0; j < detections.size(); ++j) {
+                double v = box_iou(pred, detections[j]);
+                if (v >= cfg.min_iou) pairs.push_back(pair_score(v, (int)i, (int)j));
+            }
+        }
+        std::sort(pairs.begin(), pairs.end(), [](const pair_score &a, const pair_score &b) { return a.iou > b.iou; });
+
+        std::vector<int> det_track(detections.size(), -1);
+        std::vector<bool> track_used(tracks.size(), false);
+        for (const auto &p : pairs) {
+            if (track_used[p.track] || det_track[p.det] >= 0) continue;
+            track_used[p.track] = true;
+            det_track[p.det] = p.track;
+        }
+
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            if (!track_used[i]) tracks[i].misses++;
+        }
+        for (size_t j = 0; j < detections.size(); ++j) {
+            const cv::Rect &d = detections[j];
+            if (det_track[j] >= 0) {
+                track &t = tracks[det_track[j]];
+                double r = sq(cfg.measure_noise * d.width);
+                t.k[0].update(d.x + d.width * 0.5, r);
+                t.k[1].update(d.y + d.height * 0.5, r);
+                t.k[2].update(d.width, r);
+                t.k[3].update(d.height, r);
+                t.misses = 0;
+                t.last = d;
+            } else {
+                track t;
+                t.id = next_id++;
+                double r = sq(cfg.measure_noise * d.width);
+                t.k[0].init(d.x + d.width * 0.5, r);
+                t.k[1].init(d.y + d.height * 0.5, r);
+                t.k[2].init(d.width, r);
+                t.k[3].init(d.height, r);
+                t.misses = 0;
+                t.last = d;
+                tracks.push_back(t);
+            }
+        }
+
+        int keep = cfg.smooth ? cfg.max_coast : 0;
+        tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                    [keep](const track &t) { return t.misses > keep; }),
+                     tracks.end());
+
+        out.clear();
+        ids.clear();
+        for (const auto &t : tracks) {
+            out.push_back(cfg.smooth ? t.predicted() : t.last);
+            ids.push_back(t.id);
+        }
+    }
+
+    void reset() { tracks.clear(); }
+    size_t size() const { return tracks.size(); }
+
+private:
+    struct track
+    {
+        int id;
+        int misses;
+        cv::Rect last;          // 最後一次配到的偵測框
+        kalman_1d k[4];         // cx, cy, w, h
+
+        cv::Rect predicted() const
+        {
+            double w = std::max(k[2].p, 1.0), h = std::max(k[3].p, 1.0);
+            return cv::Rect(cvRound(k[0].p - w * 0.5), cvRound(k[1].p - h * 0.5), cvRound(w), cvRound(h));
+        }
+    };
+
+    struct pair_score
+    {
+        double iou;
+        int track;
+        int det;
+        pair_score(double v, int t, int d) : iou(v), track(t), det(d) {}
+    };
+
+    static double sq(double x) { return x * x; }
+
+    assoc_config cfg;
+    int next_id;
+    std::vector<track> tracks;
+};
+
+#endif // TRACK_ASSOC_H
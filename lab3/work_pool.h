@@ -0,0 +1,150 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+// 板子上的 OpenCV 沒有 TBB，自己寫一個小的 work-stealing thread pool
+// 每個 thread 有自己的 task queue，自己的做完就從別人的 queue 前面偷，
+// 這樣每個 task 花的時間不一樣 (例如 pyramid 不同層) 也不會有 thread 閒著。
+// 呼叫 parallel_for 的 thread 也算一個 worker，threads = 4 只會多開 3 個 thread。
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+class work_pool
+{
+public:
+    explicit work_pool(int threads)
+        : queues(std::max(threads, 1)), job(nullptr), pending(0), generation(0), stop(false)
+    {
+        for (int i = 1; i < (int)queues.size(); ++i) {
+            workers.push_back(std::thread(&work_pool::worker_loop, this, i));
+        }
+        // 等每個 thread 報上 tid，建好之後 thread_ids 就是完整的
+        std::unique_lock<std::mutex> lk(state_mutex);
+        done.wait(lk, [this] { return tids.size() == workers.size(); });
+    }
+
+    ~work_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(state_mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers) t.join();
+    }
+
+    int size() const { return (int)queues.size(); }
+
+    // 多開的 thread 的 Linux tid (stage_stats 幫它們各開一組 perf 計數器)
+    const std::vector<pid_t> &thread_ids() const { return tids; }
+
+    // 對 0 ~ n-1 各呼叫一次 fn，全部做完才回傳；fn 不能再呼叫 parallel_for
+    void parallel_for(int n, const std::function<void(int)> &fn)
+    {
+        if (n <= 0) return;
+        if (queues.size() == 1 || n == 1) {
+            for (int i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(state_mutex);
+            job = &fn;
+            pending = n;
+            for (int i = 0; i < n; ++i) {
+                task_queue &q = queues[i % queues.size()];
+                std::lock_guard<std::mutex> qlk(q.m);
+                q.tasks.push_back(i);
+            }
+            generation++;
+        }
+        wake.notify_all();
+
+        run_tasks(0);
+        std::unique_lock<std::mutex> lk(state_mutex);
+        done.wait(lk, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct task_queue
+    {
+        std::mutex m;
+        std::deque<int> tasks;
+    };
+
+    // 先拿自己 queue 的最後一個，沒有就從其他 queue 的最前面偷
+    bool pop(int self, int &task)
+    {
+        {
+            task_queue &q = queues[self];
+            std::lock_guard<std::mutex> lk(q.m);
+            if (!q.tasks.empty()) {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); ++k) {
+            task_queue &q = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lk(q.m);
+            if (!q.tasks.empty()) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run_tasks(int self)
+    {
+        int task;
+        while (pop(self, task)) {
+            (*job)(task);
+            std::lock_guard<std::mutex> lk(state_mutex);
+            if (--pending == 0) done.notify_all();
+        }
+    }
+
+    void worker_loop(int self)
+    {
+        {
+            std::lock_guard<std::mutex> lk(state_mutex);
+            tids.push_back((pid_t)syscall(SYS_gettid));
+        }
+        done.notify_all();
+        unsigned seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(state_mutex);
+                wake.wait(lk, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            run_tasks(self);
+        }
+    }
+
+    std::vector<task_queue> queues;
+    std::vector<std::thread> workers;
+    std::vector<pid_t> tids;
+    const std::function<void(int)> *job;
+
+    std::mutex state_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    int pending;
+    unsigned generation;
+    bool stop;
+};
+
+#endif // WORK_POOL_H